@@ -0,0 +1,174 @@
+#include "batchProcess.hpp"
+#include "boundedQueue.hpp"
+#include "vectorExport/vectorExport.hpp"
+#include "templateFile/templateWriter.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+batchProcess::batchProcess(const std::string &inputDir, const std::string &outputDir, int jobs, int clusters)
+    : inputDir(inputDir), outputDir(outputDir), jobs(std::max(1, jobs)), clusters(clusters)
+{
+}
+
+void batchProcess::setRegionEngine(regionEngine engine)
+{
+    this->engine = engine;
+}
+
+void batchProcess::setColourSpace(colourSpace space)
+{
+    this->space = space;
+}
+
+void batchProcess::setVectorFormat(const std::string &format)
+{
+    vectorFormat = format;
+}
+
+bool batchProcess::run()
+{
+    if (!collectInputs()) return false;
+
+    std::error_code ec;
+    fs::create_directories(outputDir, ec);
+    if (ec)
+    {
+        std::cerr << "Error: Could not create output directory " << outputDir << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    // Parallelism comes from running several images at once, so keep OpenCV's
+    // own pool from oversubscribing the cores underneath the workers.
+    if (jobs > 1) cv::setNumThreads(1);
+
+    // decode and encode are mostly IO/zlib bound, a few threads keep the workers fed
+    const int ioThreads = std::max(1, jobs / 4);
+    boundedQueue<decodedImage> decoded(jobs * 2);
+    boundedQueue<processedImage> processed(jobs * 2);
+
+    std::atomic<size_t> nextInput{0};
+    std::atomic<int> decodersLeft{ioThreads}, workersLeft{jobs};
+    std::atomic<int> failed{0}, written{0};
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < ioThreads; i++) {
+        threads.emplace_back([&] {
+            for (size_t idx = nextInput++; idx < inputs.size(); idx = nextInput++) {
+                cv::Mat img;
+                try {
+                    img = cv::imread(inputs[idx].string(), cv::IMREAD_COLOR);
+                } catch (const cv::Exception&) {}
+                if (img.empty()) {
+                    std::cerr << "Error: Could not decode " << inputs[idx] << std::endl;
+                    failed++;
+                    continue;
+                }
+                decoded.push({inputs[idx], std::move(img)});
+            }
+            if (--decodersLeft == 0) decoded.close();
+        });
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        threads.emplace_back([&] {
+            while (auto item = decoded.pop()) {
+                try {
+                    imageProcess image(item->imgBGR);
+                    image.setRegionEngine(engine);
+                    image.setColourSpace(space);
+                    if (!image.processImage(clusters)) {
+                        std::cerr << "Error: Failed to process " << item->source << std::endl;
+                        failed++;
+                        continue;
+                    }
+                    processed.push({item->source, image.getProcessedImage(), image.getPalette(), image.getRegions(), image.getLabelPositions()});
+                } catch (const std::exception& err) {
+                    std::cerr << "Error processing " << item->source << ": " << err.what() << std::endl;
+                    failed++;
+                }
+            }
+            if (--workersLeft == 0) processed.close();
+        });
+    }
+
+    for (int i = 0; i < ioThreads; i++) {
+        threads.emplace_back([&] {
+            while (auto result = processed.pop()) {
+                if (writeTemplate(*result)) written++;
+                else failed++;
+            }
+        });
+    }
+
+    for (auto& thread : threads) thread.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    int done = written.load();
+    std::cout << "Processed " << done << "/" << inputs.size() << " images in " << seconds << " s ("
+              << (seconds > 0 ? done / seconds : 0.0) << " images/sec, " << jobs << " workers)";
+    if (failed.load() > 0) std::cout << ", " << failed.load() << " failed";
+    std::cout << std::endl;
+
+    return failed.load() == 0;
+}
+
+bool batchProcess::collectInputs()
+{
+    static const std::vector<std::string> extensions = {".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".webp"};
+
+    std::error_code ec;
+    if (!fs::is_directory(inputDir, ec))
+    {
+        std::cerr << "Error: Input directory does not exist: " << inputDir << std::endl;
+        return false;
+    }
+
+    for (const auto& entry : fs::directory_iterator(inputDir, ec)) {
+        if (!entry.is_regular_file()) continue;
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (std::find(extensions.begin(), extensions.end(), ext) != extensions.end()) {
+            inputs.push_back(entry.path());
+        }
+    }
+    std::sort(inputs.begin(), inputs.end());
+
+    if (inputs.empty())
+    {
+        std::cerr << "Error: No images found in " << inputDir << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool batchProcess::writeTemplate(const processedImage& result) const
+{
+    fs::path stem = outputDir / result.source.stem();
+
+    fs::path pngPath = stem;
+    pngPath += ".png";
+    if (!cv::imwrite(pngPath.string(), result.templateImage))
+    {
+        std::cerr << "Error: Could not write " << pngPath << std::endl;
+        return false;
+    }
+
+    fs::path vectorPath = stem;
+    vectorPath += "." + vectorFormat;
+    vectorExport exporter(result.templateImage.size(), result.regions, result.labelPositions, result.palette);
+    if (!(vectorFormat == "pdf" ? exporter.writePDF(vectorPath.string()) : exporter.writeSVG(vectorPath.string()))) return false;
+
+    // regions themselves, so the template can be shown or exported again without reprocessing
+    fs::path regionsPath = stem;
+    regionsPath += ".cbt";
+    templateWriter writer(result.templateImage.size(), result.regions, result.labelPositions, result.palette);
+    return writer.write(regionsPath.string());
+}
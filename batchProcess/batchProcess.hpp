@@ -0,0 +1,46 @@
+#pragma once
+#include <opencv4/opencv2/opencv.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "regionInfo.hpp"
+#include "imageProcess/imageProcess.hpp"
+
+// Headless batch mode: streams every image in a directory through
+// decode -> quantize/edges/labels -> encode, with the three stages
+// overlapping across threads and linked by bounded queues.
+// Never touches SFML windows or textures, so it runs without a display.
+class batchProcess
+{
+    public:
+        batchProcess(const std::string &inputDir, const std::string &outputDir, int jobs, int clusters);
+        void setRegionEngine(regionEngine engine);
+        void setColourSpace(colourSpace space);
+        void setVectorFormat(const std::string &format); // "svg" or "pdf"
+        bool run();
+
+    private:
+        struct decodedImage {
+            std::filesystem::path source;
+            cv::Mat imgBGR;
+        };
+
+        struct processedImage {
+            std::filesystem::path source;
+            cv::Mat templateImage;
+            cv::Mat palette;
+            std::vector<regionInfo> regions;
+            std::vector<cv::Point> labelPositions;
+        };
+
+        std::filesystem::path inputDir, outputDir;
+        int jobs;
+        int clusters;
+        regionEngine engine = regionEngine::contours;
+        colourSpace space = colourSpace::bgr;
+        std::string vectorFormat = "svg";
+        std::vector<std::filesystem::path> inputs;
+
+        bool collectInputs();
+        bool writeTemplate(const processedImage& result) const;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// Fixed-capacity blocking queue linking the batch pipeline stages.
+// push() blocks while full so a fast decoder can't run ahead of the workers
+// and hold every image in memory; pop() returns nullopt once closed and drained.
+template <typename T>
+class boundedQueue
+{
+    public:
+        explicit boundedQueue(size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+        bool push(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+            if (closed) return false;
+            items.push_back(std::move(item));
+            notEmpty.notify_one();
+            return true;
+        }
+
+        std::optional<T> pop()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+            if (items.empty()) return std::nullopt;
+            T item = std::move(items.front());
+            items.pop_front();
+            notFull.notify_one();
+            return item;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            notEmpty.notify_all();
+            notFull.notify_all();
+        }
+
+    private:
+        size_t capacity;
+        bool closed = false;
+        std::deque<T> items;
+        std::mutex mutex;
+        std::condition_variable notEmpty, notFull;
+};
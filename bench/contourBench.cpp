@@ -0,0 +1,121 @@
+// Duplicate-contour filtering before/after the centroid grid.
+// Runs the getContours dedupe step on flower.png scaled to 4K and 8K:
+//   legacy: contourArea inside the sort comparator + linear scan of stored centroids
+//   grid:   areas cached before the sort + centroidGrid lookups
+#include "imageProcess/centroidGrid.hpp"
+#include <opencv4/opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+using contourList = std::vector<std::vector<cv::Point>>;
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool centroidOf(const std::vector<cv::Point>& contour, cv::Point& centroid)
+{
+    cv::Moments moments = cv::moments(contour, false);
+    if (moments.m00 == 0) return false;
+    centroid = cv::Point(static_cast<int>(moments.m10 / moments.m00), static_cast<int>(moments.m01 / moments.m00));
+    return true;
+}
+
+size_t legacyDedupe(contourList contours, double minDist, double areaThreshold)
+{
+    std::stable_sort(contours.begin(), contours.end(), [](const std::vector<cv::Point>& a, const std::vector<cv::Point>& b) { return cv::contourArea(a) > cv::contourArea(b); });
+
+    std::vector<std::pair<cv::Point, double>> storedRegions;
+    for (const auto& contour : contours) {
+        double area = cv::contourArea(contour);
+        cv::Point centroid;
+        if (!centroidOf(contour, centroid)) continue;
+
+        bool valid = true;
+        for (const auto& stored : storedRegions) {
+            double distance = cv::norm(centroid - stored.first);
+            double areaDiff = std::abs(area - stored.second) / stored.second;
+            if (distance < minDist && areaDiff < areaThreshold) {
+                valid = false;
+                break;
+            }
+        }
+        if (valid) storedRegions.emplace_back(centroid, area);
+    }
+    return storedRegions.size();
+}
+
+size_t gridDedupe(const contourList& contours, double minDist, double areaThreshold)
+{
+    std::vector<double> areas(contours.size());
+    std::vector<size_t> order(contours.size());
+    for (size_t i = 0; i < contours.size(); i++) {
+        areas[i] = cv::contourArea(contours[i]);
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&areas](size_t a, size_t b) { return areas[a] > areas[b]; });
+
+    centroidGrid storedRegions(minDist, areaThreshold);
+    size_t kept = 0;
+    for (size_t idx : order) {
+        cv::Point centroid;
+        if (!centroidOf(contours[idx], centroid)) continue;
+        if (storedRegions.isDuplicate(centroid, areas[idx])) continue;
+        storedRegions.insert(centroid, areas[idx]);
+        kept++;
+    }
+    return kept;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string imagePath = argc > 1 ? argv[1] : "images/flower.png";
+    cv::Mat img = cv::imread(imagePath, cv::IMREAD_COLOR);
+    if (img.empty()) {
+        std::cerr << "Error: Could not load " << imagePath << std::endl;
+        return 1;
+    }
+
+    const double minDist = 3.0, areaThreshold = 0.1;
+    for (int longSide : {3840, 7680}) {
+        double scale = static_cast<double>(longSide) / std::max(img.cols, img.rows);
+        cv::Mat scaled, lab, edges;
+        cv::resize(img, scaled, cv::Size(), scale, scale, cv::INTER_CUBIC);
+
+        // same kind of edge map getContours sees: per-channel Lab Canny, closed
+        cv::cvtColor(scaled, lab, cv::COLOR_BGR2Lab);
+        std::vector<cv::Mat> channels;
+        cv::split(lab, channels);
+        edges = cv::Mat::zeros(scaled.size(), CV_8UC1);
+        for (const auto& channel : channels) {
+            cv::Mat channelEdges;
+            cv::Canny(channel, channelEdges, 30, 90);
+            edges |= channelEdges;
+        }
+        cv::morphologyEx(edges, edges, cv::MORPH_CLOSE, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3)));
+
+        contourList contours;
+        std::vector<cv::Vec4i> hierarchy;
+        cv::findContours(edges, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
+
+        auto start = std::chrono::steady_clock::now();
+        size_t legacyKept = legacyDedupe(contours, minDist, areaThreshold);
+        double legacyMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        size_t gridKept = gridDedupe(contours, minDist, areaThreshold);
+        double gridMs = elapsedMs(start);
+
+        std::cout << scaled.cols << "x" << scaled.rows << ": " << contours.size() << " contours\n"
+                  << "  legacy: " << legacyMs << " ms, kept " << legacyKept << "\n"
+                  << "  grid:   " << gridMs << " ms, kept " << gridKept
+                  << " (" << (gridMs > 0 ? legacyMs / gridMs : 0.0) << "x)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Whole-pipeline benchmark over a folder of images at several scales and
+// cluster counts. Every run is profiled per stage and written as one JSON line,
+// so results can be diffed between commits or engines.
+//   pipelineBench [images_dir] [results.jsonl]
+#include "imageProcess/imageProcess.hpp"
+#include "quantizer/fastQuantizer.hpp"
+#include "quantizer/histogramQuantizer.hpp"
+#include "quantizer/kmeansQuantizer.hpp"
+#include "quantizer/simdKernels.hpp"
+#include <opencv4/opencv2/opencv.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct benchConfig {
+    const char *name;
+    regionEngine engine;
+    colourSpace space;
+    std::unique_ptr<colourQuantizer> (*makeQuantizer)();
+};
+
+const benchConfig configs[] = {
+    {"histogram+contours", regionEngine::contours, colourSpace::bgr, [] { return std::unique_ptr<colourQuantizer>(std::make_unique<histogramQuantizer>()); }},
+    {"histogram+components", regionEngine::components, colourSpace::bgr, [] { return std::unique_ptr<colourQuantizer>(std::make_unique<histogramQuantizer>()); }},
+    {"fast+contours", regionEngine::contours, colourSpace::bgr, [] { return std::unique_ptr<colourQuantizer>(std::make_unique<fastQuantizer>()); }},
+    {"fast+contours+lab", regionEngine::contours, colourSpace::lab, [] { return std::unique_ptr<colourQuantizer>(std::make_unique<fastQuantizer>()); }},
+    {"kmeans+contours", regionEngine::contours, colourSpace::bgr, [] { return std::unique_ptr<colourQuantizer>(std::make_unique<kmeansQuantizer>()); }},
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    fs::path imageDir = argc > 1 ? argv[1] : "images";
+    std::ofstream results;
+    if (argc > 2) {
+        results.open(argv[2]);
+        if (!results) {
+            std::cerr << "Error: Could not write " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = argc > 2 ? results : std::cout;
+
+    std::vector<fs::path> inputs;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(imageDir, ec)) {
+        if (entry.is_regular_file()) inputs.push_back(entry.path());
+    }
+    std::sort(inputs.begin(), inputs.end());
+
+    const double scales[] = {0.5, 1.0, 2.0};
+    const int clusterCounts[] = {4, 10, 20};
+
+    for (const auto& input : inputs) {
+        cv::Mat img = cv::imread(input.string(), cv::IMREAD_COLOR);
+        if (img.empty()) {
+            std::cerr << "skipping " << input.filename() << " (not decodable here)" << std::endl;
+            continue;
+        }
+
+        for (double scale : scales) {
+            cv::Mat scaled;
+            cv::resize(img, scaled, cv::Size(), scale, scale, scale < 1 ? cv::INTER_AREA : cv::INTER_CUBIC);
+
+            for (int clusters : clusterCounts) {
+                for (const auto& config : configs) {
+                    // alternative engines are compared at the default colour count, kmeans is too slow to upscale
+                    if (&config != &configs[0] && clusters != 10) continue;
+                    if (std::string(config.name).rfind("kmeans", 0) == 0 && scale > 1) continue;
+
+                    stageProfiler profiler;
+                    imageProcess image(scaled);
+                    image.setQuantizer(config.makeQuantizer());
+                    image.setRegionEngine(config.engine);
+                    image.setColourSpace(config.space);
+                    image.setProfiler(&profiler);
+                    bool ok = image.processImage(clusters);
+
+                    profiler.info("image", input.filename().string());
+                    profiler.info("config", config.name);
+                    profiler.info("status", ok ? "ok" : "failed");
+                    profiler.info("kernel", simdKernels::activeKernel());
+                    profiler.count("scale", scale);
+                    profiler.count("width", scaled.cols);
+                    profiler.count("height", scaled.rows);
+                    profiler.count("clusters", clusters);
+                    out << profiler.toJSON() << std::endl;
+
+                    double totalMs = 0;
+                    for (const auto& stage : profiler.getStages()) totalMs += stage.ms;
+                    std::cerr << input.filename().string() << " " << scaled.cols << "x" << scaled.rows << " k=" << clusters
+                              << " " << config.name << ": " << totalMs << " ms" << (ok ? "" : " (failed)") << std::endl;
+                }
+            }
+        }
+
+        // Colour count sweep 2..20 at full size, a fresh imageProcess per run
+        // against one session that reuses edges, contours and the last palette
+        for (bool session : {false, true}) {
+            stageProfiler profiler;
+            std::unique_ptr<imageProcess> image;
+            bool ok = true;
+            for (int clusters = 2; clusters <= 20; clusters++) {
+                if (!session || !image) {
+                    image = std::make_unique<imageProcess>(img);
+                    image->setProfiler(&profiler);
+                }
+                ok &= image->processImage(clusters);
+            }
+
+            profiler.info("image", input.filename().string());
+            profiler.info("config", session ? "sweep session" : "sweep fresh");
+            profiler.info("status", ok ? "ok" : "failed");
+            profiler.count("width", img.cols);
+            profiler.count("height", img.rows);
+            profiler.count("runs", 19);
+            out << profiler.toJSON() << std::endl;
+
+            double totalMs = 0;
+            for (const auto& stage : profiler.getStages()) totalMs += stage.ms;
+            std::cerr << input.filename().string() << " k=2..20 " << (session ? "session" : "fresh") << ": "
+                      << totalMs << " ms" << (ok ? "" : " (failed)") << std::endl;
+        }
+    }
+    return 0;
+}
@@ -1,44 +1,240 @@
 #include "displayTemplate.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 
-displayTemplate::displayTemplate(const cv::Mat& img) 
+displayTemplate::displayTemplate(const cv::Mat& img) : fullSize(img.size())
 {
-    toSFML(img);
+    tileSize = static_cast<int>(std::min<unsigned>(maxTileSize, sf::Texture::getMaximumSize()));
+    levels = buildPyramid(img, tileSize);
 }
 
-void displayTemplate::run() 
+displayTemplate::displayTemplate(const cv::Mat& preview, cv::Size fullSize, std::function<cv::Mat()> refine) : fullSize(fullSize)
 {
-    sf::RenderWindow window(sf::VideoMode(1280, 960), "Colour with numbers template");
+    tileSize = static_cast<int>(std::min<unsigned>(maxTileSize, sf::Texture::getMaximumSize()));
+    levels = buildPyramid(preview, tileSize);
+    levelScale = preview.cols > 0 ? static_cast<float>(fullSize.width) / preview.cols : 1.0f;
+
+    // The pyramid is built on the worker too, the window only swaps it in
+    refining = true;
+    worker = std::thread([this, refine] {
+        std::vector<cv::Mat> result;
+        try {
+            cv::Mat full = refine();
+            if (!full.empty()) result = buildPyramid(full, tileSize);
+        } catch (const std::exception& err) {
+            std::cerr << "Error processing image: " << err.what() << std::endl;
+        }
+        std::lock_guard<std::mutex> guard(refinedLock);
+        refinedLevels = std::move(result);
+        refinedReady = true;
+    });
+}
+
+displayTemplate::~displayTemplate()
+{
+    if (worker.joinable()) worker.join();
+}
+
+void displayTemplate::run()
+{
+    sf::RenderWindow window(sf::VideoMode(1280, 960), refining ? "Colour with numbers template (preview)" : "Colour with numbers template");
     sf::Vector2u windowSize = window.getSize();
-    sf::Vector2u textureSize = processedTexture.getSize();
+    sf::View view = window.getView();
+    fitView(view, windowSize);
 
-    float scale = std::min(static_cast<float>(windowSize.x) / textureSize.x,
-                            static_cast<float>(windowSize.y) / textureSize.y);
+    bool dragging = false;
+    sf::Vector2i lastMouse;
+    bool dirty = true;
 
-    imageSprite.setTexture(processedTexture);
-    imageSprite.setScale(scale, scale);
-    imageSprite.setPosition((windowSize.x - textureSize.x * scale) / 2, (windowSize.y - textureSize.y * scale) / 2);
+    auto zoomAt = [&](float factor, sf::Vector2i pixel) {
+        sf::Vector2f before = window.mapPixelToCoords(pixel, view);
+        view.zoom(factor);
+        sf::Vector2f after = window.mapPixelToCoords(pixel, view);
+        view.move(before.x - after.x, before.y - after.y);
+    };
 
-    while (window.isOpen()) 
+    while (window.isOpen())
     {
         sf::Event event;
-        while (window.pollEvent(event)) 
+        while (window.pollEvent(event))
         {
-            if (event.type == sf::Event::Closed) 
-            {
-                window.close();
+            switch (event.type) {
+                case sf::Event::Closed:
+                    window.close();
+                    break;
+                case sf::Event::Resized: {
+                    // keep the zoom level, show more or less of the template
+                    float worldPerPixel = view.getSize().x / std::max(1u, windowSize.x);
+                    windowSize = sf::Vector2u(event.size.width, event.size.height);
+                    view.setSize(windowSize.x * worldPerPixel, windowSize.y * worldPerPixel);
+                    break;
+                }
+                case sf::Event::MouseWheelScrolled:
+                    zoomAt(event.mouseWheelScroll.delta > 0 ? 0.8f : 1.25f, sf::Vector2i(event.mouseWheelScroll.x, event.mouseWheelScroll.y));
+                    break;
+                case sf::Event::MouseButtonPressed:
+                    if (event.mouseButton.button == sf::Mouse::Left) {
+                        dragging = true;
+                        lastMouse = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+                    }
+                    break;
+                case sf::Event::MouseButtonReleased:
+                    if (event.mouseButton.button == sf::Mouse::Left) dragging = false;
+                    break;
+                case sf::Event::MouseMoved: {
+                    if (!dragging) continue;
+                    sf::Vector2i mouse(event.mouseMove.x, event.mouseMove.y);
+                    sf::Vector2f from = window.mapPixelToCoords(lastMouse, view);
+                    sf::Vector2f to = window.mapPixelToCoords(mouse, view);
+                    view.move(from.x - to.x, from.y - to.y);
+                    lastMouse = mouse;
+                    break;
+                }
+                case sf::Event::KeyPressed: {
+                    const float step = view.getSize().x * 0.1f;
+                    sf::Vector2i centre(static_cast<int>(windowSize.x / 2), static_cast<int>(windowSize.y / 2));
+                    switch (event.key.code) {
+                        case sf::Keyboard::Escape: window.close(); break;
+                        case sf::Keyboard::Left: view.move(-step, 0); break;
+                        case sf::Keyboard::Right: view.move(step, 0); break;
+                        case sf::Keyboard::Up: view.move(0, -step); break;
+                        case sf::Keyboard::Down: view.move(0, step); break;
+                        case sf::Keyboard::Add:
+                        case sf::Keyboard::Equal: zoomAt(0.8f, centre); break;
+                        case sf::Keyboard::Subtract:
+                        case sf::Keyboard::Hyphen: zoomAt(1.25f, centre); break;
+                        case sf::Keyboard::Num0:
+                        case sf::Keyboard::Home: fitView(view, windowSize); break;
+                        default: continue;
+                    }
+                    break;
+                }
+                case sf::Event::GainedFocus:
+                    break;
+                default:
+                    continue; // nothing visible changed
             }
+            dirty = true;
+        }
+
+        if (refinedReady && adoptRefined()) {
+            window.setTitle("Colour with numbers template");
+            dirty = true;
         }
-        window.clear();
-        window.draw(imageSprite);
+
+        if (!window.isOpen()) break;
+        if (!dirty) {
+            sf::sleep(sf::milliseconds(15));
+            continue;
+        }
+        window.setView(view);
+        window.clear(sf::Color(64, 64, 64));
+        drawTiles(window);
         window.display();
+        dirty = false;
+    }
+
+    if (worker.joinable()) {
+        if (!refinedReady) std::cout << "Waiting for the full resolution template to finish..." << std::endl;
+        worker.join();
+    }
+}
+
+std::vector<cv::Mat> displayTemplate::buildPyramid(const cv::Mat& img, int tileSize)
+{
+    std::vector<cv::Mat> pyramid{img};
+    while (std::max(pyramid.back().cols, pyramid.back().rows) > tileSize) {
+        const cv::Mat& last = pyramid.back();
+        cv::Mat half;
+        cv::resize(last, half, cv::Size((last.cols + 1) / 2, (last.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+        pyramid.push_back(half);
+    }
+    return pyramid;
+}
+
+bool displayTemplate::adoptRefined()
+{
+    std::lock_guard<std::mutex> guard(refinedLock);
+    refinedReady = false;
+    refining = false;
+    if (refinedLevels.empty()) return false; // refinement failed, keep the preview
+    levels = std::move(refinedLevels);
+    levelScale = 1.0f;
+    tiles.clear();
+    recentlyUsed.clear();
+    return true;
+}
+
+int displayTemplate::chooseLevel(float worldPerPixel) const
+{
+    // coarsest level that still has at least one texel per screen pixel
+    int level = 0;
+    while (level + 1 < static_cast<int>(levels.size()) && levelScale * std::pow(2.0f, level + 1) <= worldPerPixel) level++;
+    return level;
+}
+
+const sf::Texture& displayTemplate::tileTexture(int level, int tx, int ty)
+{
+    const uint64_t key = (static_cast<uint64_t>(level) << 48) | (static_cast<uint64_t>(ty) << 24) | static_cast<uint64_t>(tx);
+    auto found = tiles.find(key);
+    if (found != tiles.end()) {
+        recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, found->second.use);
+        return found->second.texture;
+    }
+
+    if (tiles.size() >= cacheCapacity) {
+        tiles.erase(recentlyUsed.back());
+        recentlyUsed.pop_back();
+    }
+
+    const cv::Mat& img = levels[level];
+    cv::Rect area(tx * tileSize, ty * tileSize, std::min(tileSize, img.cols - tx * tileSize), std::min(tileSize, img.rows - ty * tileSize));
+    cv::Mat tileRGBA;
+    cv::cvtColor(img(area), tileRGBA, cv::COLOR_BGR2RGBA);
+
+    recentlyUsed.push_front(key);
+    cachedTile& tile = tiles[key];
+    tile.use = recentlyUsed.begin();
+    tile.texture.create(area.width, area.height);
+    tile.texture.update(tileRGBA.ptr());
+    tile.texture.setSmooth(true);
+    return tile.texture;
+}
+
+void displayTemplate::drawTiles(sf::RenderWindow& window)
+{
+    const sf::View& view = window.getView();
+    const sf::Vector2f centre = view.getCenter(), size = view.getSize();
+    const float worldPerPixel = size.x / std::max(1.0f, static_cast<float>(window.getSize().x));
+
+    const int level = chooseLevel(worldPerPixel);
+    const cv::Mat& img = levels[level];
+    const float scale = levelScale * std::pow(2.0f, level); // full size pixels per level pixel
+    const float tileWorld = tileSize * scale;
+
+    // only the tiles overlapping the view
+    const int x0 = std::max(0, static_cast<int>(std::floor((centre.x - size.x / 2) / tileWorld)));
+    const int y0 = std::max(0, static_cast<int>(std::floor((centre.y - size.y / 2) / tileWorld)));
+    const int x1 = std::min((img.cols - 1) / tileSize, static_cast<int>(std::floor((centre.x + size.x / 2) / tileWorld)));
+    const int y1 = std::min((img.rows - 1) / tileSize, static_cast<int>(std::floor((centre.y + size.y / 2) / tileWorld)));
+
+    sf::Sprite sprite;
+    for (int ty = y0; ty <= y1; ty++) {
+        for (int tx = x0; tx <= x1; tx++) {
+            sprite.setTexture(tileTexture(level, tx, ty), true);
+            sprite.setPosition(tx * tileWorld, ty * tileWorld);
+            sprite.setScale(scale, scale);
+            window.draw(sprite);
+        }
     }
 }
 
-void displayTemplate::toSFML(const cv::Mat& img) 
+void displayTemplate::fitView(sf::View& view, sf::Vector2u windowSize) const
 {
-    cv::Mat imgRGBA;
-    cv::cvtColor(img, imgRGBA, cv::COLOR_BGR2RGBA);
-    sf::Image processedImage;
-    processedImage.create(imgRGBA.cols, imgRGBA.rows, imgRGBA.ptr());
-    processedTexture.loadFromImage(processedImage);
+    // whole template in the window, centred, aspect kept
+    float scale = std::max(static_cast<float>(fullSize.width) / windowSize.x,
+                           static_cast<float>(fullSize.height) / windowSize.y);
+    view.setSize(windowSize.x * scale, windowSize.y * scale);
+    view.setCenter(fullSize.width / 2.0f, fullSize.height / 2.0f);
 }
@@ -1,16 +1,57 @@
 #pragma once
 #include <SFML/Graphics.hpp>
 #include <opencv4/opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
-class displayTemplate 
+// Zoomable viewer for templates of any size. The template is cut into a
+// pyramid of tiles (level 0 full size, every level half the one before),
+// tiles are uploaded when they first come into view and kept in an LRU
+// texture cache, so neither the GPU texture limit nor VRAM caps the size.
+// The window is only redrawn after an event; idle, the loop sleeps.
+class displayTemplate
 {
     public:
         displayTemplate(const cv::Mat &img);
+        // Shows preview (a template of a downscaled copy) stretched to fullSize
+        // straight away and swaps in the result of refine, run on a background thread
+        displayTemplate(const cv::Mat &preview, cv::Size fullSize, std::function<cv::Mat()> refine);
+        ~displayTemplate();
         void run();
 
     private:
-        sf::Texture processedTexture;
-        sf::Sprite imageSprite;
+        struct cachedTile {
+            sf::Texture texture;
+            std::list<uint64_t>::iterator use;
+        };
 
-        void toSFML(const cv::Mat& img);
-};
\ No newline at end of file
+        static constexpr int maxTileSize = 512;
+        static constexpr size_t cacheCapacity = 128; // tiles, 128 MB of RGBA at 512 px
+
+        cv::Size fullSize;
+        std::vector<cv::Mat> levels; // BGR pyramid of what is shown now
+        float levelScale = 1;        // full size pixels per level 0 pixel, above 1 for the preview
+        int tileSize = maxTileSize;
+
+        std::unordered_map<uint64_t, cachedTile> tiles;
+        std::list<uint64_t> recentlyUsed; // front is the most recent
+
+        std::thread worker;
+        std::mutex refinedLock;
+        std::vector<cv::Mat> refinedLevels;
+        std::atomic<bool> refinedReady{false};
+        bool refining = false;
+
+        static std::vector<cv::Mat> buildPyramid(const cv::Mat &img, int tileSize);
+        bool adoptRefined();
+        int chooseLevel(float worldPerPixel) const;
+        const sf::Texture& tileTexture(int level, int tx, int ty);
+        void drawTiles(sf::RenderWindow &window);
+        void fitView(sf::View &view, sf::Vector2u windowSize) const;
+};
@@ -0,0 +1,41 @@
+#include "centroidGrid.hpp"
+#include <cmath>
+
+centroidGrid::centroidGrid(double minDist, double areaThreshold)
+    : minDist(minDist), areaThreshold(areaThreshold), cellSize(std::max(minDist, 1.0))
+{
+}
+
+bool centroidGrid::isDuplicate(cv::Point centroid, double area) const
+{
+    const int cx = cellOf(centroid.x), cy = cellOf(centroid.y);
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            auto it = cells.find(key(cx + dx, cy + dy));
+            if (it == cells.end()) continue;
+            for (const auto& stored : it->second) {
+                double distance = cv::norm(centroid - stored.first);
+                double areaDiff = std::abs(area - stored.second) / stored.second; // Relative area difference
+                if (distance < minDist && areaDiff < areaThreshold) {
+                    return true; // too similar
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void centroidGrid::insert(cv::Point centroid, double area)
+{
+    cells[key(cellOf(centroid.x), cellOf(centroid.y))].emplace_back(centroid, area);
+}
+
+int centroidGrid::cellOf(int coord) const
+{
+    return static_cast<int>(std::floor(coord / cellSize));
+}
+
+int64_t centroidGrid::key(int cx, int cy)
+{
+    return static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy));
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <opencv4/opencv2/opencv.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid over the (centroid, area) pairs of kept contours, used to spot
+// near-duplicate contours. Cells are minDist wide so every stored centroid
+// closer than minDist sits in the 3x3 cells around the query: O(1) amortized
+// per lookup instead of a scan over everything kept so far.
+class centroidGrid
+{
+    public:
+        centroidGrid(double minDist, double areaThreshold);
+        bool isDuplicate(cv::Point centroid, double area) const;
+        void insert(cv::Point centroid, double area);
+
+    private:
+        double minDist, areaThreshold;
+        double cellSize;
+        std::unordered_map<int64_t, std::vector<std::pair<cv::Point, double>>> cells;
+
+        int cellOf(int coord) const;
+        static int64_t key(int cx, int cy);
+};
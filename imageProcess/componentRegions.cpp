@@ -0,0 +1,255 @@
+#include "componentRegions.hpp"
+#include <algorithm>
+
+namespace {
+
+// Moore neighbourhood, clockwise on screen (y points down) starting east
+const cv::Point neighbours[8] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+int directionOf(cv::Point d)
+{
+    for (int i = 0; i < 8; i++) {
+        if (neighbours[i] == d) return i;
+    }
+    return 4;
+}
+
+} // namespace
+
+componentRegions::componentRegions(const cv::Mat &labels, cv::Size size, int minArea)
+    : labelMap(nullptr), width(size.width), height(size.height), minArea(minArea)
+{
+    if (labels.type() == CV_32S && labels.isContinuous() && labels.total() == static_cast<size_t>(size.area())) {
+        labelMap = labels.ptr<int>();
+    }
+}
+
+bool componentRegions::extract(std::vector<regionInfo> &regions)
+{
+    if (!labelMap || width <= 0 || height <= 0) return false;
+
+    int count = labelComponents();
+    count = mergeSmallRegions(count);
+
+    // per-region stats in one sweep, the first pixel met in raster order is the
+    // top-left one and always lies on the outer boundary (it may be a merged
+    // speck, so the cluster comes from the region, not from that pixel)
+    std::vector<double> area(count, 0), sumX(count, 0), sumY(count, 0);
+    std::vector<cv::Point> start(count, cv::Point(-1, -1));
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int id = ids[y * width + x];
+            if (start[id].x < 0) start[id] = cv::Point(x, y);
+            area[id] += 1;
+            sumX[id] += x;
+            sumY[id] += y;
+        }
+    }
+
+    regions.reserve(regions.size() + count);
+    for (int id = 0; id < count; id++) {
+        if (area[id] == 0) continue;
+        regionInfo region;
+        region.contour = traceBoundary(start[id]);
+        region.clusterLabel = clusters[id];
+        region.centroid = cv::Point(static_cast<int>(sumX[id] / area[id]), static_cast<int>(sumY[id] / area[id]));
+        region.area = area[id];
+        regions.push_back(std::move(region));
+    }
+
+    // same order getContours produces, largest first
+    std::sort(regions.begin(), regions.end(), [](const regionInfo& a, const regionInfo& b) { return a.area > b.area; });
+    return true;
+}
+
+int componentRegions::labelComponents()
+{
+    ids.assign(static_cast<size_t>(width) * height, 0);
+    std::vector<int> parent, parentCluster;
+    parent.reserve(1024);
+    parentCluster.reserve(1024);
+
+    for (int y = 0; y < height; y++) {
+        const int* row = labelMap + y * width;
+        int* idRow = ids.data() + y * width;
+        for (int x = 0; x < width; x++) {
+            const bool joinLeft = x > 0 && row[x - 1] == row[x];
+            const bool joinUp = y > 0 && row[x - width] == row[x];
+            if (joinLeft) {
+                idRow[x] = idRow[x - 1];
+                if (joinUp) {
+                    int a = find(parent, idRow[x - 1]), b = find(parent, idRow[x - width]);
+                    if (a != b) parent[std::max(a, b)] = std::min(a, b);
+                }
+            } else if (joinUp) {
+                idRow[x] = idRow[x - width];
+            } else {
+                idRow[x] = static_cast<int>(parent.size());
+                parent.push_back(idRow[x]);
+                parentCluster.push_back(row[x]);
+            }
+        }
+    }
+
+    // compact root ids to 0..count-1
+    std::vector<int> compact(parent.size(), -1);
+    int count = 0;
+    clusters.clear();
+    for (size_t i = 0; i < parent.size(); i++) {
+        int root = find(parent, static_cast<int>(i));
+        if (compact[root] < 0) {
+            compact[root] = count++;
+            clusters.push_back(parentCluster[root]);
+        }
+        compact[i] = compact[root];
+    }
+    for (auto& id : ids) id = compact[id];
+    return count;
+}
+
+int componentRegions::mergeSmallRegions(int count)
+{
+    if (minArea <= 1) return count;
+
+    std::vector<int> area(count, 0);
+    for (int id : ids) area[id]++;
+
+    // Every pixel edge between a small region and a neighbour, grouped by the
+    // small region with a counting pass (no sort, linear in the pixel count)
+    std::vector<size_t> contactStart(count + 1, 0);
+    auto forEachContact = [&](auto&& visit) {
+        for (int y = 0; y < height; y++) {
+            const int* row = ids.data() + y * width;
+            for (int x = 0; x < width; x++) {
+                if (x + 1 < width && row[x] != row[x + 1]) visit(row[x], row[x + 1]);
+                if (y + 1 < height && row[x] != row[x + width]) visit(row[x], row[x + width]);
+            }
+        }
+    };
+    forEachContact([&](int a, int b) {
+        if (area[a] < minArea) contactStart[a + 1]++;
+        if (area[b] < minArea) contactStart[b + 1]++;
+    });
+    for (int id = 0; id < count; id++) contactStart[id + 1] += contactStart[id];
+    std::vector<int> contacts(contactStart[count]);
+    std::vector<size_t> fill(contactStart.begin(), contactStart.end() - 1);
+    forEachContact([&](int a, int b) {
+        if (area[a] < minArea) contacts[fill[a]++] = b;
+        if (area[b] < minArea) contacts[fill[b]++] = a;
+    });
+    fill.clear();
+    fill.shrink_to_fit();
+
+    std::vector<int> small;
+    for (int id = 0; id < count; id++) {
+        if (area[id] < minArea) small.push_back(id);
+    }
+    std::stable_sort(small.begin(), small.end(), [&](int a, int b) { return area[a] < area[b]; });
+
+    std::vector<int> parent(count);
+    for (int id = 0; id < count; id++) parent[id] = id;
+    std::vector<int> merged(area);
+    // members of every group as a linked list, so a grown group is judged by
+    // the borders of everything already merged into it
+    std::vector<int> nextMember(count, -1), lastMember(count);
+    for (int id = 0; id < count; id++) lastMember[id] = id;
+    std::vector<int> shared(count, 0), touched;
+
+    for (int id : small) {
+        int self = find(parent, id);
+        if (merged[self] >= minArea) continue; // already grown past the threshold
+
+        // shared border length with every neighbouring group; the group is
+        // below minArea, so this walks fewer than minArea members' contacts
+        touched.clear();
+        for (int member = self; member >= 0; member = nextMember[member]) {
+            if (area[member] >= minArea) continue; // only small ones have contacts recorded
+            for (size_t c = contactStart[member]; c < contactStart[member + 1]; c++) {
+                int neighbour = find(parent, contacts[c]);
+                if (neighbour == self) continue;
+                if (shared[neighbour] == 0) touched.push_back(neighbour);
+                shared[neighbour]++;
+            }
+        }
+        int best = -1, bestShared = 0;
+        for (int neighbour : touched) {
+            if (shared[neighbour] > bestShared) {
+                best = neighbour;
+                bestShared = shared[neighbour];
+            }
+            shared[neighbour] = 0;
+        }
+        if (best < 0) continue;
+
+        parent[self] = best;
+        merged[best] += merged[self];
+        nextMember[lastMember[best]] = self;
+        lastMember[best] = lastMember[self];
+    }
+
+    // a merged region keeps the cluster of the one it was merged into
+    std::vector<int> compact(count, -1), kept;
+    int remaining = 0;
+    for (int id = 0; id < count; id++) {
+        int root = find(parent, id);
+        if (compact[root] < 0) {
+            compact[root] = remaining++;
+            kept.push_back(clusters[root]);
+        }
+        compact[id] = compact[root];
+    }
+    for (auto& id : ids) id = compact[id];
+    clusters.swap(kept);
+    return remaining;
+}
+
+std::vector<cv::Point> componentRegions::traceBoundary(cv::Point start) const
+{
+    const int id = ids[start.y * width + start.x];
+    auto inside = [&](cv::Point p) {
+        return p.x >= 0 && p.y >= 0 && p.x < width && p.y < height && ids[p.y * width + p.x] == id;
+    };
+
+    std::vector<cv::Point> contour{start};
+    cv::Point current = start;
+    int backtrack = 4; // start is the top-left pixel, its west neighbour is outside
+    cv::Point second(-1, -1);
+    int lastDirection = -1;
+    const size_t maxSteps = 4 * static_cast<size_t>(width) * height + 8;
+
+    for (size_t step = 0; step < maxSteps; step++) {
+        int found = -1;
+        for (int i = 1; i <= 8; i++) {
+            int d = (backtrack + i) % 8;
+            if (inside(current + neighbours[d])) {
+                found = d;
+                break;
+            }
+        }
+        if (found < 0) break; // single pixel region
+
+        cv::Point next = current + neighbours[found];
+        if (current == start && next == second) break; // back where we started, same way round
+        if (contour.size() == 1) second = next;
+
+        // the last outside pixel checked becomes the backtrack of the next pixel
+        cv::Point outside = current + neighbours[(found + 7) % 8];
+        backtrack = directionOf(outside - next);
+        current = next;
+        // keep only the corners, like CHAIN_APPROX_SIMPLE
+        if (found == lastDirection && contour.size() > 1) contour.back() = current;
+        else contour.push_back(current);
+        lastDirection = found;
+    }
+    if (contour.size() > 1 && contour.back() == start) contour.pop_back();
+    return contour;
+}
+
+int componentRegions::find(std::vector<int> &parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <opencv4/opencv2/opencv.hpp>
+#include <vector>
+#include "regionInfo.hpp"
+
+// Region engine working straight off the quantized label map: union-find
+// connected components (4-connected, same cluster), small regions merged into
+// the neighbour they share the longest border with (counting everything already
+// merged into them), then one Moore trace per region for its outer boundary.
+// Linear in the pixel count for a fixed minArea, no sorting, filtering or Canny.
+class componentRegions
+{
+    public:
+        componentRegions(const cv::Mat &labels, cv::Size size, int minArea);
+        bool extract(std::vector<regionInfo> &regions);
+
+    private:
+        const int* labelMap; // row-major cluster id per pixel
+        int width, height;
+        int minArea;
+        std::vector<int> ids; // region id per pixel
+        std::vector<int> clusters; // cluster id per region id
+
+        int labelComponents();
+        int mergeSmallRegions(int count);
+        std::vector<cv::Point> traceBoundary(cv::Point start) const;
+
+        static int find(std::vector<int> &parent, int i);
+};
@@ -1,106 +1,241 @@
 #include "imageProcess.hpp"
+#include "quantizer/histogramQuantizer.hpp"
+#include "componentRegions.hpp"
+#include <cmath>
 #include <iostream>
 
-imageProcess::imageProcess(const std::string &filename)
+imageProcess::imageProcess(const std::string &filename) : quantizer(std::make_unique<histogramQuantizer>())
 {
     // TODO support for transparent bg pictures
-    if (!texture.loadFromFile(filename)) 
+    // Decode straight to BGR, no texture upload and read back through SFML
+    imgBGR = cv::imread(filename, cv::IMREAD_COLOR);
+    if (imgBGR.empty()) 
     {
-        std::cerr << "Error: Could not load texture from: " << filename << std::endl;
+        std::cerr << "Error: Could not load image from: " << filename << std::endl;
     }
-    toOpenCV();
+}
+
+imageProcess::imageProcess(const cv::Mat &img) : imgBGR(img), quantizer(std::make_unique<histogramQuantizer>())
+{
 }
 
 bool imageProcess::processImage (int clusters)
 {
-    if (!groupColours(clusters)) return false;
-    if (!detectEdges()) return false;
+    // Quantization is the only stage that depends on clusters, the edge and
+    // contour stages return straight away when their cached result is still valid
+    if (clusters != quantizedClusters && !groupColours(clusters)) return false;
+    if (engine == regionEngine::contours && !detectEdges()) return false;
     if (!highlightContours()) return false;
     return true;
 }
 
+const cv::Mat& imageProcess::getSourceImage() const
+{
+    return imgBGR;
+}
+
 const cv::Mat& imageProcess::getProcessedImage() const 
 { 
     return imgWithBorders; 
 }
 
+const std::vector<regionInfo>& imageProcess::getRegions() const
+{
+    return regions;
+}
+
+const std::vector<cv::Point>& imageProcess::getLabelPositions() const
+{
+    return labelPositions;
+}
+
+const cv::Mat& imageProcess::getPalette() const
+{
+    return centre;
+}
+
+const cv::Mat& imageProcess::getQuantizedImage()
+{
+    // Built on first request only, most runs never look at it
+    if (imgQuantized.empty() && !labels.empty() && centre.rows > 0 && centre.rows <= 256)
+    {
+        cv::Mat lut(1, 256, CV_8UC3, cv::Scalar(0, 0, 0));
+        for (int c = 0; c < centre.rows; c++) {
+            lut.at<cv::Vec3b>(0, c) = cv::Vec3b(centre.at<uchar>(c, 0), centre.at<uchar>(c, 1), centre.at<uchar>(c, 2));
+        }
+
+        // cluster ids fit a byte, so the whole pass is one vectorised cv::LUT
+        cv::Mat labels8U, labels3;
+        labels.reshape(1, imgBGR.rows).convertTo(labels8U, CV_8U);
+        cv::merge(std::vector<cv::Mat>{labels8U, labels8U, labels8U}, labels3);
+        cv::LUT(labels3, lut, imgQuantized);
+    }
+    return imgQuantized;
+}
+
+void imageProcess::setQuantizer(std::unique_ptr<colourQuantizer> engine)
+{
+    if (!engine) return;
+    quantizer = std::move(engine);
+    quantizedClusters = 0;
+}
+
+void imageProcess::setRegionEngine(regionEngine engine, int minRegionArea)
+{
+    this->engine = engine;
+    this->minRegionArea = minRegionArea;
+}
+
+void imageProcess::setColourSpace(colourSpace space)
+{
+    if (space == this->space) return;
+    this->space = space;
+    quantizedClusters = 0; // palette has to be learned again, without a warm start
+}
+
+void imageProcess::setEdgeThresholds(double low, double high)
+{
+    if (low == cannyLow && high == cannyHigh) return;
+    cannyLow = low;
+    cannyHigh = high;
+    // filtered channels stay, Canny and everything after it reruns
+    edges.release();
+    contoursFound = false;
+}
+
+void imageProcess::setProfiler(stageProfiler *profiler)
+{
+    this->profiler = profiler;
+}
+
 bool imageProcess::groupColours(int clusters)
 {   
-    // TODO add error cases
-    cv::Mat imgReshaped = imgBGR.reshape(1, imgBGR.rows * imgBGR.cols);
-    imgReshaped.convertTo(imgReshaped, CV_32F);  // Convert to float for k-means
-    cv::kmeans (imgReshaped, clusters, labels, cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 100, 3.0), 3, cv::KMEANS_RANDOM_CENTERS, centre); 
-    return reformQuantize();
+    if (imgBGR.empty()) return false;
+    {
+        stageTimer timer(profiler, "groupColours");
+        // Lab mode clusters the same Lab image detectEdges filters, converted once
+        if (space == colourSpace::lab && imgLAB.empty()) {
+            cv::cvtColor(imgBGR, imgLAB, cv::COLOR_BGR2Lab);
+        }
+        const cv::Mat& input = space == colourSpace::lab ? imgLAB : imgBGR;
+
+        // Going up in colours, the previous palette is already a good start for most of them
+        if (quantizedClusters > 0 && quantizedClusters < clusters) {
+            quantizer->setWarmStart(quantizerCentre);
+        }
+        quantizedClusters = 0;
+        if (!quantizer->quantize(input, clusters, labels, centre)) return false;
+        quantizerCentre = centre.clone();
+    }
+    if (!reformQuantize()) return false;
+    quantizedClusters = clusters;
+    return true;
 }
 
 bool imageProcess::reformQuantize()
 {
-    // reform a photo to check quantization results
+    stageTimer timer(profiler, "reformQuantize");
     centre.convertTo(centre, CV_8U); // cap 255
-    cv::Mat imgQuantized(imgBGR.size(), imgBGR.type());
-    for (int i = 0; i < imgBGR.rows; i++)
-    {
-        for (int j = 0; j < imgBGR.cols; j++)
-        {
-            int cluster_idx = labels.at<int>(i * imgBGR.cols + j);
-            imgQuantized.at<cv::Vec3b>(i, j) = centre.row(cluster_idx);  
-        }
+    if (space == colourSpace::lab) {
+        // palette back to BGR for drawing and export, the labels don't change
+        cv::Mat paletteBGR;
+        cv::cvtColor(centre.reshape(3, centre.rows), paletteBGR, cv::COLOR_Lab2BGR);
+        centre = paletteBGR.reshape(1, centre.rows);
     }
-
-    // cv::imshow("quantized", imgQuantized);
-    // cv::waitKey(0);
+    imgQuantized.release(); // rebuilt lazily by getQuantizedImage()
     return true;
 }
 
-bool imageProcess::detectEdges() 
+bool imageProcess::filterChannels()
 {
-    cv::Mat imgLAB;
-    cv::cvtColor(imgBGR, imgLAB, cv::COLOR_BGR2Lab);
+    stageTimer timer(profiler, "filterChannels");
+    if (imgLAB.empty()) cv::cvtColor(imgBGR, imgLAB, cv::COLOR_BGR2Lab);
 
     std::vector<cv::Mat> labChannels;
     cv::split(imgLAB, labChannels);
 
-    // process separate chanels
-    std::vector<cv::Mat> edgeChannels;
-    for (const auto& channel : labChannels) {
-        cv::Mat channelEdges;
-        cv::Mat filtered;
-        cv::bilateralFilter(channel, filtered, 9, 75, 75);
-        
-        cv::Canny(filtered, channelEdges, 30, 90);
-        edgeChannels.push_back(channelEdges);
+    // Bilateral filter every (channel, tile) pair on the thread pool. Each tile is
+    // filtered with a halo of the filter radius so its pixels see exactly the
+    // neighbourhood they would in a whole-image pass, the result is bit-identical.
+    const int diameter = 9;
+    const int halo = diameter / 2;
+    const int tileSize = 512;
+
+    std::vector<cv::Rect> tiles;
+    for (int y = 0; y < imgLAB.rows; y += tileSize) {
+        for (int x = 0; x < imgLAB.cols; x += tileSize) {
+            tiles.emplace_back(x, y, std::min(tileSize, imgLAB.cols - x), std::min(tileSize, imgLAB.rows - y));
+        }
     }
 
-    edges = cv::Mat::zeros(imgLAB.size(), CV_8UC1);
-    for (const auto& channelEdges : edgeChannels) {
+    const cv::Rect bounds(0, 0, imgLAB.cols, imgLAB.rows);
+    filteredLab.resize(labChannels.size());
+    for (auto& channel : filteredLab) channel.create(imgLAB.size(), CV_8UC1);
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(labChannels.size() * tiles.size())), [&](const cv::Range& range) {
+        for (int job = range.start; job < range.end; job++) {
+            const size_t ch = job / tiles.size();
+            const cv::Rect& tile = tiles[job % tiles.size()];
+            const cv::Rect padded = cv::Rect(tile.x - halo, tile.y - halo, tile.width + 2 * halo, tile.height + 2 * halo) & bounds;
+
+            cv::Mat tileFiltered;
+            cv::bilateralFilter(labChannels[ch](padded), tileFiltered, diameter, 75, 75);
+            tileFiltered(cv::Rect(tile.x - padded.x, tile.y - padded.y, tile.width, tile.height)).copyTo(filteredLab[ch](tile));
+        }
+    });
+    return true;
+}
+
+bool imageProcess::detectEdges() 
+{
+    if (!edges.empty()) return true;
+    if (filteredLab.empty() && !filterChannels()) return false;
+
+    stageTimer timer(profiler, "detectEdges");
+    // Canny's hysteresis follows edges across the whole image so it can't be tiled
+    // without changing the result; OpenCV already splits each call into stripes.
+    edges = cv::Mat::zeros(imgBGR.size(), CV_8UC1);
+    for (const auto& channel : filteredLab) {
+        cv::Mat channelEdges;
+        cv::Canny(channel, channelEdges, cannyLow, cannyHigh);
         edges |= channelEdges;
     }
 
     cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
     cv::morphologyEx(edges, edges, cv::MORPH_CLOSE, kernel);
+    contoursFound = false;
 
     return true;
 }
 
-bool imageProcess::getContours()
+bool imageProcess::findContourCandidates()
 {
+    stageTimer timer(profiler, "findContours");
     // Find contours (all regions with color transitions)
     std::vector<std::vector<cv::Point>> contours;
     std::vector<cv::Vec4i> hierarchy;
     cv::findContours(edges, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
-
-    std::sort(contours.begin(), contours.end(), [](const std::vector<cv::Point>& a, const std::vector<cv::Point>& b) { return cv::contourArea(a) > cv::contourArea(b); });
+    if (profiler) profiler->count("contoursFound", static_cast<double>(contours.size()));
+
+    // Areas computed once up front, not on every comparison of the sort; equal
+    // areas keep findContours order so the kept set is deterministic
+    std::vector<double> areas(contours.size());
+    std::vector<size_t> order(contours.size());
+    for (size_t i = 0; i < contours.size(); i++) {
+        areas[i] = cv::contourArea(contours[i]);
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&areas](size_t a, size_t b) { return areas[a] > areas[b]; });
     
-    std::vector<std::pair<cv::Point, double>> storedRegions; // Store (centroid, area)
     double minDist = 3.0;  
     double areaThreshold = 0.1; 
+    centroidGrid storedRegions(minDist, areaThreshold); // Store (centroid, area)
 
-    
-    // Draw black borders around color regions
-    for (const auto& contour : contours) {
-        cv::drawContours(imgWithBorders, std::vector<std::vector<cv::Point>>{contour}, 0, cv::Scalar(0, 0, 0), 2, cv::LINE_AA);
-        
-        double area = cv::contourArea(contour);
+    // Nothing here depends on the colours, so the result is kept for later runs
+    contourCandidates.clear();
+    for (size_t idx : order) {
+        const auto& contour = contours[idx];
+        double area = areas[idx];
         // Only process large enough regions
         // if (area < 200) continue;
 
@@ -112,110 +247,166 @@ bool imageProcess::getContours()
             // Check if this centroid is too close to an existing one
             cv::Point centroid(centerX, centerY);
 
-            if (validContour(storedRegions, centroid, area, minDist, areaThreshold)) {
+            if (validContour(storedRegions, centroid, area)) {
 
-                storedRegions.emplace_back(centroid, area); // Store (centroid, area)
+                storedRegions.insert(centroid, area); // Store (centroid, area)
                 
                 // Ensure centroid is within image bounds
                 if (centerX >= 0 && centerX < imgBGR.cols && centerY >= 0 && centerY < imgBGR.rows) {
-                    int labelIndex = centerY * imgBGR.cols + centerX;
-
-                    if (labelIndex >= 0 && labelIndex < labels.total()) {
-                        int clusterLabel = labels.at<int>(labelIndex);
-
-                        if (clusterLabel >= 0 && clusterLabel < centre.rows) {
-                            regionInfo region;
-                            region.contour = contour;
-                            region.clusterLabel = clusterLabel;
-                            region.centroid = cv::Point(centerX, centerY);
-                            region.area = area;
-                            regions.push_back(region);
-                            
-                        }
-                    }
+                    regionInfo region;
+                    region.contour = contour;
+                    region.clusterLabel = -1;
+                    region.centroid = centroid;
+                    region.area = area;
+                    contourCandidates.push_back(std::move(region));
                 }
             }
         }
     }
+    contoursFound = true;
     return true;
 }
 
-bool imageProcess::validContour(const std::vector<std::pair<cv::Point, double>>& storedRegions, cv::Point centroid, double area, double minDist, double areaThreshold) 
+bool imageProcess::getContours()
 {
-    for (const auto& stored : storedRegions) {
-        double distance = cv::norm(centroid - stored.first);
-        double areaDiff = std::abs(area - stored.second) / stored.second; // Relative area difference
-        if (distance < minDist && areaDiff < areaThreshold) {
-            return false; // reject it, too similar
+    if (!contoursFound && !findContourCandidates()) return false;
+
+    stageTimer timer(profiler, "getContours");
+    // Colour of each region is the cluster under its centroid
+    regions.reserve(contourCandidates.size());
+    for (const auto& candidate : contourCandidates) {
+        int labelIndex = candidate.centroid.y * imgBGR.cols + candidate.centroid.x;
+
+        if (labelIndex >= 0 && static_cast<size_t>(labelIndex) < labels.total()) {
+            int clusterLabel = labels.at<int>(labelIndex);
+
+            if (clusterLabel >= 0 && clusterLabel < centre.rows) {
+                regions.push_back(candidate);
+                regions.back().clusterLabel = clusterLabel;
+            }
         }
     }
-    return true; 
+    return true;
+}
+
+bool imageProcess::getComponents()
+{
+    stageTimer timer(profiler, "getComponents");
+    // Regions straight from the label map, cluster ids are exact rather than sampled
+    componentRegions components(labels, imgBGR.size(), minRegionArea);
+    return components.extract(regions);
+}
+
+bool imageProcess::validContour(const centroidGrid& storedRegions, cv::Point centroid, double area) 
+{
+    return !storedRegions.isDuplicate(centroid, area); // reject it if too similar to a stored one
 }
 
 bool imageProcess::drawBorders()
 {
-    imgWithBorders = cv::Mat(edges.size(), CV_8UC3, cv::Scalar(255, 255, 255));
-    
+    stageTimer timer(profiler, "drawBorders");
+    imgWithBorders = cv::Mat(imgBGR.size(), CV_8UC3, cv::Scalar(255, 255, 255));
+
     // Draw all borders
-    for (const auto& region : regions) {
-        cv::drawContours(imgWithBorders, std::vector<std::vector<cv::Point>>{region.contour}, 0, cv::Scalar(0, 0, 0), 2, cv::LINE_AA);
-    }
-    
+    for (const auto& region : regions) drawOutline(imgWithBorders, region.contour);
     return true;
 }
 
+void imageProcess::drawOutline(cv::Mat& img, const std::vector<cv::Point>& contour)
+{
+    cv::polylines(img, contour, true, cv::Scalar(0, 0, 0), 2, cv::LINE_AA);
+}
+
 bool imageProcess::labelRegions()
 {
-    for (const auto& region : regions) {
-        // Convert OpenCV contour to mapbox polygon format
+    stageTimer timer(profiler, "labelRegions");
+
+    // Pole of inaccessibility for every region, spread over the thread pool
+    labelPositions.assign(regions.size(), cv::Point());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(regions.size())), [&](const cv::Range& range) {
+        // one polygon buffer per chunk, reused for every region in it
         mapbox::geometry::polygon<double> polygon;
-        mapbox::geometry::linear_ring<double> ring;
-        
-        // Add each point from the contour to the ring
-        for (const auto& point : region.contour) {
-            ring.push_back({static_cast<double>(point.x), static_cast<double>(point.y)});
-        }
-        // Close the ring by adding the first point again if needed
-        if (ring.front() != ring.back()) {
-            ring.push_back(ring.front());
+        polygon.emplace_back();
+        auto& ring = polygon.front();
+
+        for (int i = range.start; i < range.end; i++) {
+            const auto& region = regions[i];
+            if (region.contour.size() < 3) {
+                labelPositions[i] = region.centroid;
+                continue;
+            }
+
+            // Convert OpenCV contour to mapbox polygon format
+            ring.clear();
+            for (const auto& point : region.contour) {
+                ring.push_back({static_cast<double>(point.x), static_cast<double>(point.y)});
+            }
+            // Close the ring by adding the first point again if needed
+            if (ring.front() != ring.back()) {
+                ring.push_back(ring.front());
+            }
+
+            // Pixel precision only matters for small regions, big ones can settle sooner
+            double precision = std::max(1.0, std::sqrt(region.area) / 50.0);
+            mapbox::geometry::point<double> pole = mapbox::polylabel(polygon, precision);
+            labelPositions[i] = cv::Point(static_cast<int>(pole.x), static_cast<int>(pole.y));
         }
-        
-        polygon.push_back(ring);
-
-        // Find the pole of inaccessibility
-        mapbox::geometry::point<double> pole = mapbox::polylabel(polygon, 1.0);
-        
-        // Convert label number to string
-        std::string labelText = std::to_string(region.clusterLabel);
-        
-        int fontFace = cv::FONT_HERSHEY_PLAIN;
-        double fontScale = 1;
-        int thickness = 1;
+    });
+
+    drawLabels(imgWithBorders, static_cast<int>(regions.size()), [&](int i) { return regions[i].clusterLabel; },
+               [&](int i) { return labelPositions[i]; }, centre.rows);
+    return true;
+}
+
+void imageProcess::drawLabels(cv::Mat& img, int count, const std::function<int(int)>& clusterOf,
+                              const std::function<cv::Point(int)>& positionOf, int clusters)
+{
+    int fontFace = cv::FONT_HERSHEY_PLAIN;
+    double fontScale = 1;
+    int thickness = 1;
+
+    // Label text and metrics only depend on the cluster, measure each once
+    std::vector<std::string> labelTexts(clusters);
+    std::vector<cv::Size> textSizes(clusters);
+    for (int cluster = 0; cluster < clusters; cluster++) {
         int baseline = 0;
-        cv::Size textSize = cv::getTextSize(labelText, fontFace, fontScale, thickness, &baseline);
+        labelTexts[cluster] = std::to_string(cluster);
+        textSizes[cluster] = cv::getTextSize(labelTexts[cluster], fontFace, fontScale, thickness, &baseline);
+    }
+
+    // Drawing stays serial, putText writes into the shared image
+    for (int i = 0; i < count; i++) {
+        int cluster = clusterOf(i);
+        const cv::Size& textSize = textSizes[cluster];
+        const cv::Point pole = positionOf(i);
 
         // Ensure label is within image bounds
-        int textX = std::max(0, std::min(imgWithBorders.cols - textSize.width, 
-                        static_cast<int>(pole.x - textSize.width / 2)));
-        int textY = std::max(textSize.height, std::min(imgWithBorders.rows, 
-                        static_cast<int>(pole.y + textSize.height / 2)));
+        int textX = std::max(0, std::min(img.cols - textSize.width, 
+                        pole.x - textSize.width / 2));
+        int textY = std::max(textSize.height, std::min(img.rows, 
+                        pole.y + textSize.height / 2));
 
         // Draw the label
-        cv::putText(imgWithBorders, labelText, cv::Point(textX, textY), 
+        cv::putText(img, labelTexts[cluster], cv::Point(textX, textY), 
                 fontFace, fontScale, cv::Scalar(0, 0, 0), thickness, cv::LINE_AA);
     }
-    return true;
 }
 
 bool imageProcess::highlightContours()
 {
-    // Ensure edges is a single-channel image
-    if (edges.type() != CV_8UC1) {
-        cv::cvtColor(edges, edges, cv::COLOR_BGR2GRAY);
-    }
+    regions.clear();
+    if (engine == regionEngine::components) {
+        if (!getComponents()) return false;
+    } else {
+        // Ensure edges is a single-channel image
+        if (edges.type() != CV_8UC1) {
+            cv::cvtColor(edges, edges, cv::COLOR_BGR2GRAY);
+        }
 
-    // Extract all regions
-    if (!getContours()) return false;
+        // Extract all regions
+        if (!getContours()) return false;
+    }
+    if (profiler) profiler->count("regionsKept", static_cast<double>(regions.size()));
 
     // Draw borders
     if (!drawBorders()) return false;
@@ -225,13 +416,3 @@ bool imageProcess::highlightContours()
 
     return true;
 }
-
-void imageProcess::toOpenCV()
-{
-    sfImage = texture.copyToImage();
-    size = sfImage.getSize();
-    const sf::Uint8* pixels = sfImage.getPixelsPtr();
-    cv::Mat img(cv::Size(size.x, size.y), CV_8UC4, (void*)pixels);
-    cv::cvtColor(img, imgBGR, cv::COLOR_RGBA2BGR);
-}
-
@@ -1,31 +1,77 @@
 #pragma once
-#include <SFML/Graphics.hpp>
 #include <opencv4/opencv2/opencv.hpp>
 #include <mapbox/polylabel.hpp>
 #include "regionInfo.hpp"
+#include "quantizer/colourQuantizer.hpp"
+#include "centroidGrid.hpp"
+#include "profiler/stageProfiler.hpp"
+#include <functional>
+#include <memory>
 
+enum class regionEngine {
+    contours,   // bilateral + Canny edges, then findContours (original engine)
+    components  // connected components of the quantized label map
+};
+
+enum class colourSpace {
+    bgr,    // raw 8 bit BGR distances
+    lab     // 8 bit CIE Lab, distances closer to what the eye sees, shared with detectEdges
+};
+
+// One loaded image and everything derived from it. processImage can be called
+// again with another colour count or after a setting changed: the Lab image,
+// filtered channels, edge mask and contours are kept and only the stages after
+// the change run again. A larger colour count starts from the previous palette.
 class imageProcess 
 {
     public:
         imageProcess(const std::string &filename);
+        imageProcess(const cv::Mat &imgBGR); // already decoded BGR image
         bool processImage (int clusters);
+        const cv::Mat& getSourceImage() const;
         const cv::Mat& getProcessedImage() const;
+        const std::vector<regionInfo>& getRegions() const;
+        const std::vector<cv::Point>& getLabelPositions() const;
+        const cv::Mat& getPalette() const;
+        const cv::Mat& getQuantizedImage();
+        void setQuantizer(std::unique_ptr<colourQuantizer> engine);
+        void setRegionEngine(regionEngine engine, int minRegionArea = 50);
+        void setEdgeThresholds(double low, double high); // Canny hysteresis thresholds
+        void setColourSpace(colourSpace space); // space the palette is learned in
+        void setProfiler(stageProfiler *profiler); // null turns profiling off
+
+        // Template drawing, also used for templates loaded from a file
+        static void drawOutline(cv::Mat &img, const std::vector<cv::Point> &contour);
+        static void drawLabels(cv::Mat &img, int count, const std::function<int(int)> &clusterOf,
+                               const std::function<cv::Point(int)> &positionOf, int clusters);
 
     private:
-        sf::Texture texture;
-        sf::Image sfImage;
-        sf::Vector2u size; 
         cv::Mat imgBGR, imgWithBorders, edges, centre, labels;
-        std::vector<cv::Point> labelPositions; // Store label positions to check for overlaps
+        cv::Mat imgQuantized; // palette colour per pixel, only built on request
+        cv::Mat imgLAB;
+        cv::Mat quantizerCentre; // palette as the quantizer returned it, in the quantizing colour space
+        std::vector<cv::Mat> filteredLab; // bilateral filtered Lab channels, Canny input
+        std::vector<regionInfo> contourCandidates; // deduplicated contours, cluster not assigned yet
+        bool contoursFound = false;
+        int quantizedClusters = 0; // colour count labels and centre belong to, 0 before the first run
+        double cannyLow = 30, cannyHigh = 90;
+        std::vector<cv::Point> labelPositions; // Label pole of each region, same order as regions
         std::vector<regionInfo> regions;
+        std::unique_ptr<colourQuantizer> quantizer;
+        regionEngine engine = regionEngine::contours;
+        colourSpace space = colourSpace::bgr;
+        int minRegionArea = 50; // components smaller than this are merged into a neighbour
+        stageProfiler *profiler = nullptr;
 
         bool groupColours(int clusters);
         bool reformQuantize();
+        bool filterChannels();
         bool detectEdges();
+        bool findContourCandidates();
         bool getContours();
-        bool validContour(const std::vector<std::pair<cv::Point, double>>& storedRegions, cv::Point centroid, double area, double minDist, double areaThreshold);
+        bool getComponents();
+        bool validContour(const centroidGrid& storedRegions, cv::Point centroid, double area);
         bool drawBorders();
         bool labelRegions();
         bool highlightContours();
-        void toOpenCV();
 };
\ No newline at end of file
@@ -1,12 +1,200 @@
 #include "imageProcess/imageProcess.hpp"
 #include "displayTemplate/displayTemplate.hpp"
+#include "batchProcess/batchProcess.hpp"
+#include "vectorExport/vectorExport.hpp"
+#include "tiledProcess/tiledProcess.hpp"
+#include "templateFile/templateReader.hpp"
+#include "templateFile/templateWriter.hpp"
+#include "quantizer/simdKernels.hpp"
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <filesystem>
+#include <memory>
+#include <thread>
 
 void printUsage(const char* programName) {
-    std::cout << "\nUsage: " << programName << " <image_path> [number_of_colors]\n"
+    std::cout << "\nUsage: " << programName << " <image_path> [number_of_colors] [options]\n"
+              << "       " << programName << " --batch <in_dir> <out_dir> [-j N] [-k number_of_colors] [options]\n"
+              << "       " << programName << " --from-template <file.cbt> [--export <file.svg|file.pdf>]\n"
               << "  image_path: path to the image file\n"
-              << "  number_of_colors: (optional) number of colors to use (default: 10)\n" << std::endl;
+              << "  number_of_colors: (optional) number of colors to use (default: 10)\n"
+              << "  --batch: headless mode, writes a PNG and SVG template and a .cbt template file for every image in in_dir\n"
+              << "  --from-template: show (and --export) a saved .cbt template without processing the image again\n"
+              << "  -j N: (optional) number of images processed in parallel (default: hardware threads)\n"
+              << "  --vector svg|pdf: (optional) vector format written next to each PNG (default: svg)\n"
+              << "options:\n"
+              << "  --regions contours|components: region engine (default: contours)\n"
+              << "      contours traces Canny edges, components splits the quantized colours directly (faster)\n"
+              << "  --space bgr|lab: colour space the palette is learned in (default: bgr)\n"
+              << "      lab groups colours by how different they look, bgr by raw channel values\n"
+              << "  --export <file.svg|file.pdf>: also write the template as vector graphics\n"
+              << "  --save-template <file.cbt>: also save the regions, labels and palette for --from-template\n"
+              << "  --profile <file.json|->: write per-stage time, memory and counts as JSON (- for stdout)\n"
+              << "  --tiled <file.pgm>: out-of-core mode for huge images, streams the image in strips (best from a binary PPM)\n"
+              << "      and writes the template straight to file, no window. pixel memory is bounded by the strip size,\n"
+              << "      region bookkeeping still grows with the number of colour components (~100 bytes each)\n" << std::endl;
+}
+
+bool parseRegionEngine(const std::string& arg, regionEngine& engine) {
+    if (arg == "contours") engine = regionEngine::contours;
+    else if (arg == "components") engine = regionEngine::components;
+    else {
+        std::cerr << "Error: Unknown region engine " << arg << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool parseColourSpace(const std::string& arg, colourSpace& space) {
+    if (arg == "bgr") space = colourSpace::bgr;
+    else if (arg == "lab") space = colourSpace::lab;
+    else {
+        std::cerr << "Error: Unknown colour space " << arg << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool parseColours(const std::string& arg, int& numColors) {
+    try {
+        numColors = std::stoi(arg);
+        if (numColors < 2 || numColors > 20) {
+            std::cerr << "Error: Number of colors must be between 2 and 20\n";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid number of colors specified\n";
+        return false;
+    }
+    return true;
+}
+
+int runBatch(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Error: --batch needs an input and an output directory\n\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    int numColors = 10;
+    regionEngine engine = regionEngine::contours;
+    colourSpace space = colourSpace::bgr;
+    std::string vectorFormat = "svg";
+    for (int i = 4; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "-j" || arg == "-k" || arg == "--regions" || arg == "--space" || arg == "--vector") && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "--vector") {
+                if (value != "svg" && value != "pdf") {
+                    std::cerr << "Error: Unknown vector format " << value << "\n";
+                    return 1;
+                }
+                vectorFormat = value;
+                continue;
+            }
+            if (arg == "-k") {
+                if (!parseColours(value, numColors)) return 1;
+                continue;
+            }
+            if (arg == "--regions") {
+                if (!parseRegionEngine(value, engine)) return 1;
+                continue;
+            }
+            if (arg == "--space") {
+                if (!parseColourSpace(value, space)) return 1;
+                continue;
+            }
+            try {
+                jobs = std::stoi(value);
+            } catch (const std::exception& e) {
+                jobs = 0;
+            }
+            if (jobs < 1) {
+                std::cerr << "Error: Invalid number of jobs specified\n";
+                return 1;
+            }
+        } else {
+            std::cerr << "Error: Unknown batch option " << arg << "\n\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    batchProcess batch(argv[2], argv[3], jobs, numColors);
+    batch.setRegionEngine(engine);
+    batch.setColourSpace(space);
+    batch.setVectorFormat(vectorFormat);
+    return batch.run() ? 0 : 1;
+}
+
+int runFromTemplate(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Error: --from-template needs a .cbt file\n\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+    std::string exportPath;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--export" && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else {
+            std::cerr << "Error: Unknown option " << arg << "\n\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    templateReader reader;
+    if (!reader.open(argv[2])) return 1;
+    const cv::Mat palette = reader.getPalette();
+
+    if (!exportPath.empty()) {
+        // the exporter needs every region at once to share borders between them
+        vectorExport exporter(reader.getSize(), reader.getRegions(), reader.getLabelPositions(), palette);
+        bool pdf = std::filesystem::path(exportPath).extension() == ".pdf";
+        if (!(pdf ? exporter.writePDF(exportPath) : exporter.writeSVG(exportPath))) return 1;
+    }
+
+    // Drawn straight from the mapped arrays, one contour decoded at a time
+    cv::Mat rendered(reader.getSize(), CV_8UC3, cv::Scalar(255, 255, 255));
+    for (int i = 0; i < reader.regionCount(); i++) imageProcess::drawOutline(rendered, reader.contour(i));
+    const int32_t *cluster = reader.clusterLabels(), *labelX = reader.labelsX(), *labelY = reader.labelsY();
+    imageProcess::drawLabels(rendered, reader.regionCount(), [&](int i) { return cluster[i]; },
+                             [&](int i) { return cv::Point(labelX[i], labelY[i]); }, palette.rows);
+
+    displayTemplate display(rendered);
+    display.run();
+    return 0;
+}
+
+int runTiled(const std::string& imagePath, int numColors, const std::string& outputPath, const std::string& profilePath) {
+    stageProfiler profiler;
+    tiledProcess tiled(imagePath, numColors);
+    tiled.setProfiler(profilePath.empty() ? nullptr : &profiler);
+    if (!tiled.run(outputPath)) {
+        std::cerr << "Error: Failed to process image\n";
+        return 1;
+    }
+
+    // the template only has numbers, print what they stand for
+    const cv::Mat& palette = tiled.getPalette();
+    for (int c = 0; c < palette.rows; c++) {
+        char hex[8];
+        std::snprintf(hex, sizeof(hex), "#%02x%02x%02x", palette.at<uchar>(c, 2), palette.at<uchar>(c, 1), palette.at<uchar>(c, 0));
+        std::cout << c << ": " << hex << "\n";
+    }
+
+    if (!profilePath.empty()) {
+        profiler.info("image", imagePath);
+        profiler.info("regionEngine", "tiled");
+        profiler.info("kernel", simdKernels::activeKernel());
+        profiler.count("clusters", numColors);
+        if (!profiler.writeJSON(profilePath)) return 1;
+    }
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -14,6 +202,19 @@ int main(int argc, char* argv[]) {
         printUsage(argv[0]);
         return 0;
     }
+
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        return runBatch(argc, argv);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--from-template") {
+        try {
+            return runFromTemplate(argc, argv);
+        } catch (const std::exception& err) {
+            std::cerr << "Error showing template: " << err.what() << std::endl;
+            return 1;
+        }
+    }
     
     // Check for minimum required arguments
     if (argc < 2) {
@@ -25,26 +226,113 @@ int main(int argc, char* argv[]) {
     std::string imagePath = argv[1];
     
     int numColors = 10; // default value
-    if (argc > 2) {
-        try {
-            numColors = std::stoi(argv[2]);
-            if (numColors < 2 || numColors > 20) {
-                std::cerr << "Error: Number of colors must be between 2 and 20\n";
-                return 1;
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Error: Invalid number of colors specified\n";
+    regionEngine engine = regionEngine::contours;
+    colourSpace space = colourSpace::bgr;
+    std::string exportPath, profilePath, tiledPath, savePath;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--regions" && i + 1 < argc) {
+            if (!parseRegionEngine(argv[++i], engine)) return 1;
+        } else if (arg == "--space" && i + 1 < argc) {
+            if (!parseColourSpace(argv[++i], space)) return 1;
+        } else if (arg == "--export" && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (arg == "--save-template" && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profilePath = argv[++i];
+        } else if (arg == "--tiled" && i + 1 < argc) {
+            tiledPath = argv[++i];
+        } else if (i == 2) {
+            if (!parseColours(arg, numColors)) return 1;
+        } else {
+            std::cerr << "Error: Unknown option " << arg << "\n\n";
+            printUsage(argv[0]);
             return 1;
         }
     }
     
-    try {
-        imageProcess image(imagePath);
-        if (!image.processImage(numColors)) {
-            std::cerr << "Error: Failed to process image\n";
+    if (!tiledPath.empty()) {
+        if (!exportPath.empty() || !savePath.empty() || engine != regionEngine::contours || space != colourSpace::bgr) {
+            std::cerr << "Error: --tiled always uses its own component regions and BGR palette, it can't be combined with --export, --save-template, --regions or --space\n";
             return 1;
         }
-        
+        try {
+            return runTiled(imagePath, numColors, tiledPath, profilePath);
+        } catch (const std::exception& err) {
+            std::cerr << "Error processing image: " << err.what() << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        stageProfiler profiler;
+        stageProfiler* activeProfiler = profilePath.empty() ? nullptr : &profiler;
+
+        std::unique_ptr<imageProcess> loaded;
+        {
+            stageTimer timer(activeProfiler, "load");
+            loaded = std::make_unique<imageProcess>(imagePath);
+        }
+        imageProcess& image = *loaded;
+        image.setRegionEngine(engine);
+        image.setColourSpace(space);
+        image.setProfiler(activeProfiler);
+
+        // full resolution run plus everything that needs its result
+        auto finish = [&]() -> bool {
+            if (!image.processImage(numColors)) {
+                std::cerr << "Error: Failed to process image\n";
+                return false;
+            }
+
+            if (activeProfiler) {
+                profiler.info("image", imagePath);
+                profiler.info("regionEngine", engine == regionEngine::components ? "components" : "contours");
+                profiler.info("colourSpace", space == colourSpace::lab ? "lab" : "bgr");
+                profiler.info("kernel", simdKernels::activeKernel());
+                profiler.count("width", image.getProcessedImage().cols);
+                profiler.count("height", image.getProcessedImage().rows);
+                profiler.count("clusters", numColors);
+                if (!profiler.writeJSON(profilePath)) return false;
+            }
+
+            if (!exportPath.empty()) {
+                vectorExport exporter(image.getProcessedImage().size(), image.getRegions(), image.getLabelPositions(), image.getPalette());
+                bool pdf = std::filesystem::path(exportPath).extension() == ".pdf";
+                if (!(pdf ? exporter.writePDF(exportPath) : exporter.writeSVG(exportPath))) return false;
+            }
+
+            if (!savePath.empty()) {
+                templateWriter writer(image.getProcessedImage().size(), image.getRegions(), image.getLabelPositions(), image.getPalette());
+                if (!writer.write(savePath)) return false;
+            }
+            return true;
+        };
+
+        // Big images: show the template of a downscaled copy first, the full one
+        // is made on a background thread and replaces it in the window when done
+        const cv::Mat& source = image.getSourceImage();
+        const int previewSide = 1024;
+        if (std::max(source.cols, source.rows) > 2 * previewSide) {
+            double scale = static_cast<double>(previewSide) / std::max(source.cols, source.rows);
+            cv::Mat small;
+            cv::resize(source, small, cv::Size(), scale, scale, cv::INTER_AREA);
+            imageProcess preview(small);
+            preview.setRegionEngine(engine);
+            preview.setColourSpace(space);
+            if (preview.processImage(numColors)) {
+                bool finished = false;
+                displayTemplate display(preview.getProcessedImage(), source.size(), [&]() {
+                    finished = finish();
+                    return finished ? image.getProcessedImage() : cv::Mat();
+                });
+                display.run(); // returns once the full run is done too
+                return finished ? 0 : 1;
+            }
+        }
+
+        if (!finish()) return 1;
         displayTemplate display(image.getProcessedImage());
         display.run();
     } catch (const std::exception& err) {
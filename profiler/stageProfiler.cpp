@@ -0,0 +1,146 @@
+#include "stageProfiler.hpp"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+
+namespace {
+
+std::string escapeJSON(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        escaped += c;
+    }
+    return escaped;
+}
+
+#ifdef __linux__
+long statusFieldKB(const char* field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    const std::string prefix = std::string(field) + ":";
+    while (std::getline(status, line)) {
+        if (line.compare(0, prefix.size(), prefix) == 0) return std::stol(line.substr(prefix.size()));
+    }
+    return 0;
+}
+#endif
+
+} // namespace
+
+void stageProfiler::addStage(stage result)
+{
+    stages.push_back(std::move(result));
+}
+
+void stageProfiler::count(const std::string &key, double value)
+{
+    for (auto& counter : counters) {
+        if (counter.first == key) {
+            counter.second = value;
+            return;
+        }
+    }
+    counters.emplace_back(key, value);
+}
+
+void stageProfiler::info(const std::string &key, const std::string &value)
+{
+    infos.emplace_back(key, value);
+}
+
+const std::vector<stageProfiler::stage>& stageProfiler::getStages() const
+{
+    return stages;
+}
+
+std::string stageProfiler::toJSON() const
+{
+    std::ostringstream out;
+    double totalMs = 0;
+    out << "{";
+    for (const auto& item : infos) {
+        out << "\"" << escapeJSON(item.first) << "\": \"" << escapeJSON(item.second) << "\", ";
+    }
+    out << "\"stages\": [";
+    for (size_t i = 0; i < stages.size(); i++) {
+        const auto& s = stages[i];
+        totalMs += s.ms;
+        out << (i ? ", " : "") << "{\"name\": \"" << escapeJSON(s.name) << "\", \"ms\": " << s.ms
+            << ", \"peakRssKB\": " << s.peakRssKB << ", \"rssDeltaKB\": " << s.rssDeltaKB << "}";
+    }
+    out << "], \"counters\": {";
+    for (size_t i = 0; i < counters.size(); i++) {
+        out << (i ? ", " : "") << "\"" << escapeJSON(counters[i].first) << "\": " << counters[i].second;
+    }
+    out << "}, \"totalMs\": " << totalMs << ", \"peakRssKB\": " << peakRssKB() << "}";
+    return out.str();
+}
+
+bool stageProfiler::writeJSON(const std::string &path) const
+{
+    if (path == "-") {
+        std::cout << toJSON() << std::endl;
+        return true;
+    }
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Error: Could not write " << path << std::endl;
+        return false;
+    }
+    out << toJSON() << "\n";
+    return static_cast<bool>(out);
+}
+
+long stageProfiler::currentRssKB()
+{
+#ifdef __linux__
+    return statusFieldKB("VmRSS");
+#else
+    return 0; // no cheap portable query, deltas read as 0
+#endif
+}
+
+long stageProfiler::peakRssKB()
+{
+#ifdef __linux__
+    return statusFieldKB("VmHWM");
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+void stageProfiler::resetPeakRss()
+{
+#ifdef __linux__
+    // "5" resets VmHWM to the current RSS (Linux 4.0+), ignored if not permitted
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+}
+
+stageTimer::stageTimer(stageProfiler *profiler, const char *name) : profiler(profiler), name(name)
+{
+    if (!profiler) return;
+    stageProfiler::resetPeakRss();
+    startRssKB = stageProfiler::currentRssKB();
+    start = std::chrono::steady_clock::now();
+}
+
+stageTimer::~stageTimer()
+{
+    if (!profiler) return;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    profiler->addStage({name, ms, stageProfiler::peakRssKB(), stageProfiler::currentRssKB() - startRssKB});
+}
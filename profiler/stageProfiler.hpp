@@ -0,0 +1,52 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Collects per-stage wall time and memory plus a few counters for one run
+// of the pipeline, and dumps them as JSON (--profile).
+// Memory is resident set size: the peak while the stage ran (Linux resets the
+// high-water mark per stage, elsewhere it's the process peak so far) and the
+// change in RSS across the stage.
+class stageProfiler
+{
+    public:
+        struct stage {
+            std::string name;
+            double ms;
+            long peakRssKB;
+            long rssDeltaKB;
+        };
+
+        void addStage(stage result);
+        void count(const std::string &key, double value);
+        void info(const std::string &key, const std::string &value);
+
+        const std::vector<stage>& getStages() const;
+        std::string toJSON() const;
+        bool writeJSON(const std::string &path) const; // "-" writes to stdout
+
+        static long currentRssKB();
+        static long peakRssKB();
+        static void resetPeakRss();
+
+    private:
+        std::vector<stage> stages;
+        std::vector<std::pair<std::string, double>> counters;
+        std::vector<std::pair<std::string, std::string>> infos;
+};
+
+// Times the enclosing scope as one stage, does nothing when profiler is null.
+class stageTimer
+{
+    public:
+        stageTimer(stageProfiler *profiler, const char *name);
+        ~stageTimer();
+
+    private:
+        stageProfiler *profiler;
+        const char *name;
+        long startRssKB = 0;
+        std::chrono::steady_clock::time_point start;
+};
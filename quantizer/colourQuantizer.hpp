@@ -0,0 +1,17 @@
+#pragma once
+#include <opencv4/opencv2/opencv.hpp>
+
+// Palette engine used by imageProcess::groupColours.
+// Implementations fill labels (one CV_32S entry per pixel, row-major) and
+// centre (clusters x 3, CV_32F, BGR), the same layout cv::kmeans produces.
+class colourQuantizer 
+{
+    public:
+        virtual ~colourQuantizer() = default;
+        virtual bool quantize(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, cv::Mat& centre) = 0;
+
+        // Palette of an earlier run on the same image (k x 3, CV_32F), used once by
+        // the next quantize() with at least k clusters. Engines that can't start
+        // from given centres ignore it.
+        virtual void setWarmStart(const cv::Mat& /*centre*/) {}
+};
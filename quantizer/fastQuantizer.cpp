@@ -0,0 +1,237 @@
+#include "fastQuantizer.hpp"
+#include "simdKernels.hpp"
+#include <algorithm>
+#include <limits>
+#include <random>
+
+namespace {
+
+inline float distSq(const cv::Vec3f& a, const cv::Vec3f& b)
+{
+    float d0 = a[0] - b[0], d1 = a[1] - b[1], d2 = a[2] - b[2];
+    return d0 * d0 + d1 * d1 + d2 * d2;
+}
+
+// Draws point indices with probability proportional to their weight.
+class weightedSampler
+{
+    public:
+        weightedSampler(const std::vector<float>& weights, size_t count) : count(count)
+        {
+            if (weights.empty()) return;
+            cdf.resize(weights.size());
+            double total = 0;
+            for (size_t i = 0; i < weights.size(); i++) {
+                total += weights[i];
+                cdf[i] = total;
+            }
+        }
+
+        template <typename RNG>
+        size_t operator()(RNG& rng) const
+        {
+            if (cdf.empty()) return std::uniform_int_distribution<size_t>(0, count - 1)(rng);
+            double r = std::uniform_real_distribution<double>(0.0, cdf.back())(rng);
+            size_t idx = std::upper_bound(cdf.begin(), cdf.end(), r) - cdf.begin();
+            return std::min(idx, count - 1);
+        }
+
+    private:
+        size_t count;
+        std::vector<double> cdf;
+};
+
+} // namespace
+
+fastQuantizer::fastQuantizer(const fastQuantizerOptions& opts) : opts(opts)
+{
+}
+
+bool fastQuantizer::quantize(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, cv::Mat& centre)
+{
+    if (imgBGR.empty() || imgBGR.type() != CV_8UC3 || clusters < 1) return false;
+
+    // Learn the palette from a random subsample instead of every pixel
+    const size_t total = imgBGR.total();
+    const size_t sampleCount = std::min(total, static_cast<size_t>(std::max(opts.sampleSize, clusters)));
+    std::vector<cv::Vec3f> samples;
+    samples.reserve(sampleCount);
+
+    std::mt19937_64 rng(rngSeed());
+    std::uniform_int_distribution<size_t> pick(0, total - 1);
+    for (size_t i = 0; i < sampleCount; i++) {
+        size_t idx = sampleCount == total ? i : pick(rng);
+        const cv::Vec3b& px = imgBGR.at<cv::Vec3b>(static_cast<int>(idx / imgBGR.cols), static_cast<int>(idx % imgBGR.cols));
+        samples.emplace_back(px[0], px[1], px[2]);
+    }
+
+    std::vector<cv::Vec3f> palette;
+    std::vector<cv::Vec3f> initial = std::move(warmCentres); // one use only
+    warmCentres.clear();
+    if (!fitPalette(samples, {}, clusters, palette, initial)) return false;
+
+    assignLabels(imgBGR, palette, labels);
+
+    centre.create(clusters, 3, CV_32F);
+    for (int c = 0; c < clusters; c++) {
+        for (int ch = 0; ch < 3; ch++) {
+            centre.at<float>(c, ch) = palette[c][ch];
+        }
+    }
+    return true;
+}
+
+void fastQuantizer::setWarmStart(const cv::Mat& centre)
+{
+    warmCentres = toPalette(centre);
+}
+
+bool fastQuantizer::fitPalette(const std::vector<cv::Vec3f>& points, const std::vector<float>& weights, int clusters, std::vector<cv::Vec3f>& palette,
+                               const std::vector<cv::Vec3f>& initial) const
+{
+    const size_t n = points.size();
+    if (n == 0 || clusters < 1 || (!weights.empty() && weights.size() != n)) return false;
+
+    std::mt19937_64 rng(rngSeed());
+    weightedSampler sampler(weights, n);
+    auto weight = [&](size_t i) { return weights.empty() ? 1.0 : static_cast<double>(weights[i]); };
+
+    // k-means++ seeding, next centre drawn with probability ~ weight * D^2.
+    // A warm start keeps the previous centres and only seeds the new ones.
+    const bool warm = !initial.empty() && static_cast<int>(initial.size()) <= clusters;
+    palette.clear();
+    if (warm) {
+        palette = initial;
+    } else {
+        palette.push_back(points[sampler(rng)]);
+    }
+    std::vector<float> minDist(n);
+    for (size_t i = 0; i < n; i++) {
+        minDist[i] = std::numeric_limits<float>::max();
+        for (const auto& c : palette) minDist[i] = std::min(minDist[i], distSq(points[i], c));
+    }
+
+    while (static_cast<int>(palette.size()) < clusters) {
+        double total = 0;
+        for (size_t i = 0; i < n; i++) total += weight(i) * minDist[i];
+
+        size_t chosen = 0;
+        if (total > 0) {
+            double r = std::uniform_real_distribution<double>(0.0, total)(rng);
+            for (chosen = 0; chosen + 1 < n; chosen++) {
+                r -= weight(chosen) * minDist[chosen];
+                if (r <= 0) break;
+            }
+        }
+        // total == 0 means fewer distinct colours than clusters, the duplicate centre stays empty
+        palette.push_back(points[chosen]);
+        for (size_t i = 0; i < n; i++) minDist[i] = std::min(minDist[i], distSq(points[i], palette.back()));
+    }
+
+    // Mini-batch k-means (Sculley 2010): per-centre learning rate 1 / points seen.
+    // Skipped on a warm start, its first steps would throw the converged centres away.
+    std::vector<double> seen(clusters, 0.0);
+    std::vector<size_t> batch(std::min(static_cast<size_t>(std::max(opts.batchSize, 1)), n));
+    std::vector<int> batchLabels(batch.size());
+    std::vector<float> b0(batch.size()), b1(batch.size()), b2(batch.size());
+    for (int it = 0; !warm && it < opts.iterations; it++) {
+        for (size_t b = 0; b < batch.size(); b++) {
+            batch[b] = sampler(rng);
+            b0[b] = points[batch[b]][0];
+            b1[b] = points[batch[b]][1];
+            b2[b] = points[batch[b]][2];
+        }
+        simdKernels::nearestCentres(b0.data(), b1.data(), b2.data(), static_cast<int>(batch.size()), simdKernels::toPlanes(palette), batchLabels.data());
+        for (size_t b = 0; b < batch.size(); b++) {
+            int c = batchLabels[b];
+            seen[c] += 1.0;
+            float eta = static_cast<float>(1.0 / seen[c]);
+            palette[c] += eta * (points[batch[b]] - palette[c]);
+        }
+    }
+
+    // Polish with weighted Lloyd passes over the (small) point set, kept as
+    // channel planes so assignment and centre sums run in the SIMD kernel
+    std::vector<float> p0(n), p1(n), p2(n);
+    for (size_t i = 0; i < n; i++) {
+        p0[i] = points[i][0];
+        p1[i] = points[i][1];
+        p2[i] = points[i][2];
+    }
+    std::vector<int> assigned(n, -1), current(n);
+    const int refineIterations = warm ? opts.warmIterations : opts.refineIterations;
+    for (int it = 0; it < refineIterations; it++) {
+        std::vector<double> sums(3 * clusters, 0.0);
+        std::vector<double> mass(clusters, 0.0);
+        simdKernels::assignAndAccumulate(p0.data(), p1.data(), p2.data(), weights.empty() ? nullptr : weights.data(), static_cast<int>(n),
+                                         simdKernels::toPlanes(palette), current.data(), sums.data(), mass.data());
+        bool changed = current != assigned;
+        assigned.swap(current);
+        for (int c = 0; c < clusters; c++) {
+            if (mass[c] <= 0) continue;
+            palette[c] = cv::Vec3f(static_cast<float>(sums[3 * c] / mass[c]),
+                                   static_cast<float>(sums[3 * c + 1] / mass[c]),
+                                   static_cast<float>(sums[3 * c + 2] / mass[c]));
+        }
+        if (!changed) break;
+    }
+    return true;
+}
+
+void fastQuantizer::assignLabels(const cv::Mat& imgBGR, const std::vector<cv::Vec3f>& palette, cv::Mat& labels)
+{
+    const int cols = imgBGR.cols;
+    labels.create(imgBGR.rows * cols, 1, CV_32S);
+    const simdKernels::palettePlanes planes = simdKernels::toPlanes(palette);
+
+    cv::parallel_for_(cv::Range(0, imgBGR.rows), [&](const cv::Range& range) {
+        // pixels deinterleaved into channel planes a block at a time
+        constexpr int block = 256;
+        float b[block], g[block], r[block];
+
+        for (int y = range.start; y < range.end; y++) {
+            const uchar* src = imgBGR.ptr(y);
+            int* dst = labels.ptr<int>() + static_cast<size_t>(y) * cols;
+
+            for (int x0 = 0; x0 < cols; x0 += block) {
+                const int len = std::min(block, cols - x0);
+                for (int i = 0; i < len; i++) {
+                    b[i] = src[(x0 + i) * 3];
+                    g[i] = src[(x0 + i) * 3 + 1];
+                    r[i] = src[(x0 + i) * 3 + 2];
+                }
+                simdKernels::nearestCentres(b, g, r, len, planes, dst + x0);
+            }
+        }
+    });
+}
+
+void fastQuantizer::nearestCentres(const std::vector<cv::Vec3f>& points, const std::vector<cv::Vec3f>& palette, std::vector<int>& labels)
+{
+    const size_t n = points.size();
+    std::vector<float> p0(n), p1(n), p2(n);
+    for (size_t i = 0; i < n; i++) {
+        p0[i] = points[i][0];
+        p1[i] = points[i][1];
+        p2[i] = points[i][2];
+    }
+    labels.assign(n, 0);
+    simdKernels::nearestCentres(p0.data(), p1.data(), p2.data(), static_cast<int>(n), simdKernels::toPlanes(palette), labels.data());
+}
+
+std::vector<cv::Vec3f> fastQuantizer::toPalette(const cv::Mat& centre)
+{
+    std::vector<cv::Vec3f> palette;
+    if (centre.empty() || centre.cols != 3) return palette;
+    cv::Mat centreF;
+    centre.convertTo(centreF, CV_32F);
+    for (int c = 0; c < centreF.rows; c++) {
+        palette.emplace_back(centreF.at<float>(c, 0), centreF.at<float>(c, 1), centreF.at<float>(c, 2));
+    }
+    return palette;
+}
+
+uint64_t fastQuantizer::rngSeed() const
+{
+    return opts.deterministic ? opts.seed : std::random_device{}();
+}
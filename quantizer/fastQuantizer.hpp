@@ -0,0 +1,42 @@
+#pragma once
+#include "colourQuantizer.hpp"
+#include <cstdint>
+#include <vector>
+
+struct fastQuantizerOptions {
+    int sampleSize = 16384;     // pixels drawn from the image to learn the palette
+    int batchSize = 1024;       // points per mini-batch update
+    int iterations = 64;        // mini-batch updates
+    int refineIterations = 4;   // full Lloyd passes over the sample afterwards
+    int warmIterations = 8;     // Lloyd passes when starting from a previous palette, replaces the mini-batch
+    bool deterministic = true;  // same image + seed -> same palette and labels
+    uint64_t seed = 0x5eed;
+};
+
+// Learns the palette on a small sample (k-means++ seed, mini-batch k-means,
+// then a few Lloyd passes) and only touches every pixel once, in the final
+// nearest-centre assignment.
+class fastQuantizer : public colourQuantizer
+{
+    public:
+        fastQuantizer(const fastQuantizerOptions& opts = fastQuantizerOptions());
+        bool quantize(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, cv::Mat& centre) override;
+        void setWarmStart(const cv::Mat& centre) override;
+
+        // Palette for an arbitrary weighted point set, weights may be empty (all 1).
+        // A non-empty initial palette (at most clusters entries) is kept and only the
+        // missing centres are seeded, then Lloyd passes settle all of them.
+        bool fitPalette(const std::vector<cv::Vec3f>& points, const std::vector<float>& weights, int clusters, std::vector<cv::Vec3f>& palette,
+                        const std::vector<cv::Vec3f>& initial = {}) const;
+        static std::vector<cv::Vec3f> toPalette(const cv::Mat& centre);
+
+        // Nearest palette entry for every pixel of a CV_8UC3 image, labels become rows*cols x 1 CV_32S.
+        static void assignLabels(const cv::Mat& imgBGR, const std::vector<cv::Vec3f>& palette, cv::Mat& labels);
+        static void nearestCentres(const std::vector<cv::Vec3f>& points, const std::vector<cv::Vec3f>& palette, std::vector<int>& labels);
+
+    private:
+        fastQuantizerOptions opts;
+        std::vector<cv::Vec3f> warmCentres;
+
+        uint64_t rngSeed() const;
+};
@@ -0,0 +1,162 @@
+#include "histogramQuantizer.hpp"
+#include <array>
+#include <unordered_map>
+
+namespace {
+
+inline uint32_t packBGR(const uchar* px)
+{
+    return (static_cast<uint32_t>(px[0]) << 16) | (static_cast<uint32_t>(px[1]) << 8) | px[2];
+}
+
+inline int binIndex(const uchar* px)
+{
+    return ((px[0] >> 3) << 10) | ((px[1] >> 3) << 5) | (px[2] >> 3);
+}
+
+} // namespace
+
+histogramQuantizer::histogramQuantizer(histogramMode mode, const fastQuantizerOptions& opts) : mode(mode), engine(opts)
+{
+}
+
+bool histogramQuantizer::quantize(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, cv::Mat& centre)
+{
+    if (imgBGR.empty() || imgBGR.type() != CV_8UC3 || clusters < 1) return false;
+
+    std::vector<cv::Vec3f> palette;
+    std::vector<cv::Vec3f> initial = std::move(warmCentres); // one use only
+    warmCentres.clear();
+    bool done = false;
+    if (mode != histogramMode::binned) {
+        done = quantizeExact(imgBGR, clusters, labels, palette, initial);
+    }
+    if (!done && mode != histogramMode::exact) {
+        done = quantizeBinned(imgBGR, clusters, labels, palette, initial);
+    }
+    if (!done) return false;
+
+    centre.create(clusters, 3, CV_32F);
+    for (int c = 0; c < clusters; c++) {
+        for (int ch = 0; ch < 3; ch++) {
+            centre.at<float>(c, ch) = palette[c][ch];
+        }
+    }
+    return true;
+}
+
+void histogramQuantizer::setWarmStart(const cv::Mat& centre)
+{
+    warmCentres = fastQuantizer::toPalette(centre);
+}
+
+bool histogramQuantizer::quantizeExact(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, std::vector<cv::Vec3f>& palette,
+                                       const std::vector<cv::Vec3f>& initial) const
+{
+    // automatic mode gives up once the image looks like a photo
+    const size_t limit = mode == histogramMode::automatic ? maxExactColours : imgBGR.total();
+
+    std::unordered_map<uint32_t, int> entryOf;
+    std::vector<cv::Vec3f> colours;
+    std::vector<uint32_t> counts; // float stops counting at 2^24 pixels
+
+    for (int y = 0; y < imgBGR.rows; y++) {
+        const uchar* px = imgBGR.ptr(y);
+        uint32_t lastKey = 0;
+        int lastEntry = -1;
+        for (int x = 0; x < imgBGR.cols; x++, px += 3) {
+            uint32_t key = packBGR(px);
+            // flat art is mostly runs of one colour, skip the hash lookup for those
+            if (lastEntry < 0 || key != lastKey) {
+                auto it = entryOf.find(key);
+                if (it == entryOf.end()) {
+                    if (colours.size() >= limit) return false;
+                    it = entryOf.emplace(key, static_cast<int>(colours.size())).first;
+                    colours.emplace_back(px[0], px[1], px[2]);
+                    counts.push_back(0);
+                }
+                lastKey = key;
+                lastEntry = it->second;
+            }
+            counts[lastEntry]++;
+        }
+    }
+
+    std::vector<float> weights(counts.begin(), counts.end());
+    if (!engine.fitPalette(colours, weights, clusters, palette, initial)) return false;
+
+    std::vector<int> entryLabel;
+    fastQuantizer::nearestCentres(colours, palette, entryLabel);
+
+    const int cols = imgBGR.cols;
+    labels.create(imgBGR.rows * cols, 1, CV_32S);
+    cv::parallel_for_(cv::Range(0, imgBGR.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            const uchar* px = imgBGR.ptr(y);
+            int* dst = labels.ptr<int>() + static_cast<size_t>(y) * cols;
+            uint32_t lastKey = 0;
+            int lastLabel = -1;
+            for (int x = 0; x < cols; x++, px += 3) {
+                uint32_t key = packBGR(px);
+                if (lastLabel < 0 || key != lastKey) {
+                    lastKey = key;
+                    lastLabel = entryLabel[entryOf.find(key)->second];
+                }
+                dst[x] = lastLabel;
+            }
+        }
+    });
+    return true;
+}
+
+bool histogramQuantizer::quantizeBinned(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, std::vector<cv::Vec3f>& palette,
+                                        const std::vector<cv::Vec3f>& initial) const
+{
+    constexpr int bins = 1 << 15;
+    std::vector<std::array<uint64_t, 3>> sums(bins, {0, 0, 0});
+    std::vector<uint32_t> counts(bins, 0);
+
+    for (int y = 0; y < imgBGR.rows; y++) {
+        const uchar* px = imgBGR.ptr(y);
+        for (int x = 0; x < imgBGR.cols; x++, px += 3) {
+            int bin = binIndex(px);
+            sums[bin][0] += px[0];
+            sums[bin][1] += px[1];
+            sums[bin][2] += px[2];
+            counts[bin]++;
+        }
+    }
+
+    // each occupied bin is represented by the mean colour of its pixels
+    std::vector<cv::Vec3f> colours;
+    std::vector<float> weights;
+    std::vector<int> binEntry(bins, -1);
+    for (int bin = 0; bin < bins; bin++) {
+        if (counts[bin] == 0) continue;
+        double n = counts[bin];
+        binEntry[bin] = static_cast<int>(colours.size());
+        colours.emplace_back(static_cast<float>(sums[bin][0] / n), static_cast<float>(sums[bin][1] / n), static_cast<float>(sums[bin][2] / n));
+        weights.push_back(static_cast<float>(n));
+    }
+
+    if (!engine.fitPalette(colours, weights, clusters, palette, initial)) return false;
+
+    std::vector<int> entryLabel, binLabel(bins, 0);
+    fastQuantizer::nearestCentres(colours, palette, entryLabel);
+    for (int bin = 0; bin < bins; bin++) {
+        if (binEntry[bin] >= 0) binLabel[bin] = entryLabel[binEntry[bin]];
+    }
+
+    const int cols = imgBGR.cols;
+    labels.create(imgBGR.rows * cols, 1, CV_32S);
+    cv::parallel_for_(cv::Range(0, imgBGR.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            const uchar* px = imgBGR.ptr(y);
+            int* dst = labels.ptr<int>() + static_cast<size_t>(y) * cols;
+            for (int x = 0; x < cols; x++, px += 3) {
+                dst[x] = binLabel[binIndex(px)];
+            }
+        }
+    });
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "colourQuantizer.hpp"
+#include "fastQuantizer.hpp"
+
+enum class histogramMode {
+    exact,      // one entry per distinct BGR value
+    binned,     // 5 bits per channel, 32768 bins holding the mean colour of their pixels
+    automatic   // exact while the image has few colours (flat art), binned otherwise
+};
+
+// Reduces the image to a weighted colour histogram, clusters the histogram
+// instead of the pixels and maps pixels back through a lookup table.
+// Palette cost then scales with the number of distinct colours, not resolution.
+class histogramQuantizer : public colourQuantizer
+{
+    public:
+        histogramQuantizer(histogramMode mode = histogramMode::automatic, const fastQuantizerOptions& opts = fastQuantizerOptions());
+        bool quantize(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, cv::Mat& centre) override;
+        void setWarmStart(const cv::Mat& centre) override;
+
+    private:
+        static constexpr size_t maxExactColours = 1 << 16;
+
+        histogramMode mode;
+        fastQuantizer engine;
+        std::vector<cv::Vec3f> warmCentres;
+
+        bool quantizeExact(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, std::vector<cv::Vec3f>& palette,
+                           const std::vector<cv::Vec3f>& initial) const;
+        bool quantizeBinned(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, std::vector<cv::Vec3f>& palette,
+                            const std::vector<cv::Vec3f>& initial) const;
+};
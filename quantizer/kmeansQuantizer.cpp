@@ -0,0 +1,9 @@
+#include "kmeansQuantizer.hpp"
+
+bool kmeansQuantizer::quantize(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, cv::Mat& centre)
+{
+    cv::Mat imgReshaped = imgBGR.reshape(1, imgBGR.rows * imgBGR.cols);
+    imgReshaped.convertTo(imgReshaped, CV_32F);  // Convert to float for k-means
+    cv::kmeans (imgReshaped, clusters, labels, cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 100, 3.0), 3, cv::KMEANS_RANDOM_CENTERS, centre); 
+    return true;
+}
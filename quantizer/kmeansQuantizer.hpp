@@ -0,0 +1,10 @@
+#pragma once
+#include "colourQuantizer.hpp"
+
+// Original engine: full-resolution cv::kmeans with random restarts.
+// Slow on large photos and not reproducible, kept for comparison.
+class kmeansQuantizer : public colourQuantizer 
+{
+    public:
+        bool quantize(const cv::Mat& imgBGR, int clusters, cv::Mat& labels, cv::Mat& centre) override;
+};
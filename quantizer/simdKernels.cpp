@@ -0,0 +1,140 @@
+#include "simdKernels.hpp"
+#include <algorithm>
+#include <limits>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SIMD_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void nearestScalar(const float* c0, const float* c1, const float* c2, int n, const simdKernels::palettePlanes& palette, int* best)
+{
+    const int k = palette.size();
+    for (int i = 0; i < n; i++) {
+        float bestDist = std::numeric_limits<float>::max();
+        int bestIndex = 0;
+        for (int c = 0; c < k; c++) {
+            float d0 = c0[i] - palette.c0[c], d1 = c1[i] - palette.c1[c], d2 = c2[i] - palette.c2[c];
+            float d = d0 * d0 + d1 * d1 + d2 * d2;
+            if (d < bestDist) {
+                bestDist = d;
+                bestIndex = c;
+            }
+        }
+        best[i] = bestIndex;
+    }
+}
+
+#ifdef SIMD_KERNELS_X86
+
+// SSE2 is part of x86-64, no dispatch needed
+void nearestSSE2(const float* c0, const float* c1, const float* c2, int n, const simdKernels::palettePlanes& palette, int* best)
+{
+    const int k = palette.size();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 p0 = _mm_loadu_ps(c0 + i), p1 = _mm_loadu_ps(c1 + i), p2 = _mm_loadu_ps(c2 + i);
+        __m128 bestDist = _mm_set1_ps(std::numeric_limits<float>::max());
+        __m128i bestIndex = _mm_setzero_si128();
+        for (int c = 0; c < k; c++) {
+            const __m128 d0 = _mm_sub_ps(p0, _mm_set1_ps(palette.c0[c]));
+            const __m128 d1 = _mm_sub_ps(p1, _mm_set1_ps(palette.c1[c]));
+            const __m128 d2 = _mm_sub_ps(p2, _mm_set1_ps(palette.c2[c]));
+            const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d0, d0), _mm_mul_ps(d1, d1)), _mm_mul_ps(d2, d2));
+            const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, bestDist));
+            bestDist = _mm_min_ps(d, bestDist);
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(c)), _mm_andnot_si128(closer, bestIndex));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(best + i), bestIndex);
+    }
+    nearestScalar(c0 + i, c1 + i, c2 + i, n - i, palette, best + i);
+}
+
+__attribute__((target("avx2")))
+void nearestAVX2(const float* c0, const float* c1, const float* c2, int n, const simdKernels::palettePlanes& palette, int* best)
+{
+    const int k = palette.size();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 p0 = _mm256_loadu_ps(c0 + i), p1 = _mm256_loadu_ps(c1 + i), p2 = _mm256_loadu_ps(c2 + i);
+        __m256 bestDist = _mm256_set1_ps(std::numeric_limits<float>::max());
+        __m256 bestIndex = _mm256_setzero_ps(); // int lanes kept in a float register for blendv
+        for (int c = 0; c < k; c++) {
+            const __m256 d0 = _mm256_sub_ps(p0, _mm256_set1_ps(palette.c0[c]));
+            const __m256 d1 = _mm256_sub_ps(p1, _mm256_set1_ps(palette.c1[c]));
+            const __m256 d2 = _mm256_sub_ps(p2, _mm256_set1_ps(palette.c2[c]));
+            const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d0, d0), _mm256_mul_ps(d1, d1)), _mm256_mul_ps(d2, d2));
+            const __m256 closer = _mm256_cmp_ps(d, bestDist, _CMP_LT_OQ);
+            bestDist = _mm256_min_ps(d, bestDist);
+            bestIndex = _mm256_blendv_ps(bestIndex, _mm256_castsi256_ps(_mm256_set1_epi32(c)), closer);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(best + i), _mm256_castps_si256(bestIndex));
+    }
+    nearestSSE2(c0 + i, c1 + i, c2 + i, n - i, palette, best + i);
+}
+
+#endif
+
+typedef void (*nearestKernel)(const float*, const float*, const float*, int, const simdKernels::palettePlanes&, int*);
+
+// Chosen on first use, not during static init where OpenCV may not be set up yet
+nearestKernel nearest()
+{
+#ifdef SIMD_KERNELS_X86
+    static const nearestKernel kernel = cv::checkHardwareSupport(CV_CPU_AVX2) ? nearestAVX2 : nearestSSE2;
+    return kernel;
+#else
+    return nearestScalar;
+#endif
+}
+
+} // namespace
+
+simdKernels::palettePlanes simdKernels::toPlanes(const std::vector<cv::Vec3f> &palette)
+{
+    palettePlanes planes;
+    for (const auto& colour : palette) {
+        planes.c0.push_back(colour[0]);
+        planes.c1.push_back(colour[1]);
+        planes.c2.push_back(colour[2]);
+    }
+    return planes;
+}
+
+void simdKernels::nearestCentres(const float *c0, const float *c1, const float *c2, int n, const palettePlanes &palette, int *best)
+{
+    if (n <= 0 || palette.size() == 0) return;
+    nearest()(c0, c1, c2, n, palette, best);
+}
+
+void simdKernels::assignAndAccumulate(const float *c0, const float *c1, const float *c2, const float *weights, int n,
+                                      const palettePlanes &palette, int *best, double *sums, double *mass)
+{
+    // The scatter into per-centre sums can't be vectorised (lanes collide on the
+    // same centre), so it runs right after each block's assignment while the
+    // block is still in L1, instead of as a second pass over all pixels
+    constexpr int block = 256;
+    for (int start = 0; start < n; start += block) {
+        const int len = std::min(block, n - start);
+        nearestCentres(c0 + start, c1 + start, c2 + start, len, palette, best + start);
+        for (int i = start; i < start + len; i++) {
+            const int c = best[i];
+            const double w = weights ? weights[i] : 1.0;
+            sums[3 * c] += w * c0[i];
+            sums[3 * c + 1] += w * c1[i];
+            sums[3 * c + 2] += w * c2[i];
+            mass[c] += w;
+        }
+    }
+}
+
+const char* simdKernels::activeKernel()
+{
+#ifdef SIMD_KERNELS_X86
+    return nearest() == nearestAVX2 ? "avx2" : "sse2";
+#else
+    return "scalar";
+#endif
+}
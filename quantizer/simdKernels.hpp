@@ -0,0 +1,32 @@
+#pragma once
+#include <opencv4/opencv2/opencv.hpp>
+#include <vector>
+
+// Hand-vectorised inner loops of the quantizers. Pixels come as three
+// separate channel planes (structure of arrays) so one register holds the same
+// channel of 8 (AVX2) or 4 (SSE2) pixels. The x86 paths are picked at run time
+// through OpenCV's CPU detection, everything else takes the scalar loop.
+// All paths do the same float operations in the same order, so labels don't
+// depend on the machine. That relies on the compiler not fusing the scalar
+// loops into FMA: CMakeLists.txt builds this file with -ffp-contract=off, keep
+// it that way (and keep -ffast-math away from it).
+class simdKernels
+{
+    public:
+        // Palette split into channel planes, the layout every kernel reads
+        struct palettePlanes {
+            std::vector<float> c0, c1, c2;
+            int size() const { return static_cast<int>(c0.size()); }
+        };
+        static palettePlanes toPlanes(const std::vector<cv::Vec3f> &palette);
+
+        // Index of the nearest palette entry (squared Euclidean, first wins ties) for n pixels
+        static void nearestCentres(const float *c0, const float *c1, const float *c2, int n, const palettePlanes &palette, int *best);
+
+        // nearestCentres fused with the centre update of a Lloyd pass: every pixel is
+        // added, times its weight (null means 1), to sums[3 * c ..] and mass[c] of its centre
+        static void assignAndAccumulate(const float *c0, const float *c1, const float *c2, const float *weights, int n,
+                                        const palettePlanes &palette, int *best, double *sums, double *mass);
+
+        static const char* activeKernel(); // "avx2", "sse2" or "scalar"
+};
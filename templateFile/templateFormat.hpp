@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// On-disk layout of a .cbt template (finished regions, label poles and palette).
+//
+//   templateHeader                      fixed size, palette included
+//   double   area[regions]
+//   int32    clusterLabel[regions]
+//   int32    centroidX[regions], centroidY[regions]
+//   int32    labelX[regions], labelY[regions]
+//   uint64   contourStart[regions + 1]  first step of every contour, the last is the total
+//   int16    stepX[steps], stepY[steps]
+//
+// Every array is one flat section (structure of arrays) starting on an 8 byte
+// boundary at the offset the header gives, so a reader can map the file and
+// use the arrays in place. Numbers are little endian; the writer and reader
+// copy and map them as they are, so both only build on little endian hosts.
+// Contours are stored as steps from the previous point, the first one from
+// (0, 0). Steps that don't fit in int16 are written as the escape step
+// (-32768, -32768) followed by two steps holding the high and low 16 bits of
+// the x and y offsets: (xHigh, xLow), (yHigh, yLow).
+namespace templateFormat {
+
+constexpr char magic[4] = {'C', 'B', 'N', 'T'};
+constexpr uint32_t version = 1;
+constexpr int maxColours = 256;
+constexpr uint64_t maxPixels = uint64_t(1) << 30; // OpenCV's default decode limit, larger images never reach the writer
+constexpr int16_t escape = INT16_MIN;
+
+struct templateHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t width, height;
+    uint32_t clusters;
+    uint32_t regions;
+    uint64_t steps;
+    uint64_t fileSize;
+    // section offsets from the start of the file
+    uint64_t area, clusterLabel, centroidX, centroidY, labelX, labelY;
+    uint64_t contourStart, stepX, stepY;
+    uint8_t palette[maxColours][4]; // BGR plus one pad byte, first `clusters` used
+};
+
+// The header is written and mapped as is, so its layout is the format: any
+// padding the compiler adds would silently change the file
+static_assert(std::is_standard_layout<templateHeader>::value, "header is read straight from the file");
+static_assert(offsetof(templateHeader, version) == 4 && offsetof(templateHeader, width) == 8
+              && offsetof(templateHeader, clusters) == 16 && offsetof(templateHeader, regions) == 20
+              && offsetof(templateHeader, steps) == 24 && offsetof(templateHeader, fileSize) == 32
+              && offsetof(templateHeader, area) == 40 && offsetof(templateHeader, stepY) == 104
+              && offsetof(templateHeader, palette) == 112, "template header layout changed");
+static_assert(sizeof(templateHeader) == 1136, "template header size changed");
+static_assert(sizeof(double) == 8, "areas are stored as 64 bit IEEE doubles");
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "template files are little endian, this host would need byte swapping in templateWriter and templateReader"
+#endif
+
+// run-time check too, for compilers that don't define __BYTE_ORDER__
+inline bool littleEndianHost()
+{
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+} // namespace templateFormat
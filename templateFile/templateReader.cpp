@@ -0,0 +1,262 @@
+#include "templateReader.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+templateReader::~templateReader()
+{
+    close();
+}
+
+bool templateReader::open(const std::string &path)
+{
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        if (fd >= 0) ::close(fd);
+        std::cerr << "Error: Could not open template " << path << std::endl;
+        return false;
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = mapped == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(mapped);
+    }
+    ::close(fd); // the mapping stays valid
+    if (!data) {
+        length = 0;
+        std::cerr << "Error: Could not map template " << path << std::endl;
+        return false;
+    }
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Error: Could not open template " << path << std::endl;
+        return false;
+    }
+    copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data = copy.data();
+    length = copy.size();
+#endif
+
+    if (!validate(path)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void templateReader::close()
+{
+#ifndef _WIN32
+    if (data) munmap(const_cast<unsigned char*>(data), length);
+#endif
+    copy.clear();
+    data = nullptr;
+    length = 0;
+}
+
+bool templateReader::validate(const std::string &path) const
+{
+    using templateFormat::templateHeader;
+    if (!templateFormat::littleEndianHost()) {
+        std::cerr << "Error: Template files can only be read on little endian machines" << std::endl;
+        return false;
+    }
+    if (length < sizeof(templateHeader) || std::memcmp(data, templateFormat::magic, sizeof(templateFormat::magic)) != 0) {
+        std::cerr << "Error: " << path << " is not a template file" << std::endl;
+        return false;
+    }
+    const templateHeader& h = header();
+    if (h.version != templateFormat::version) {
+        std::cerr << "Error: " << path << " is template version " << h.version << ", this build reads version "
+                  << templateFormat::version << std::endl;
+        return false;
+    }
+    // the size is checked before anything allocates an image from it
+    if (h.fileSize != length || h.clusters > templateFormat::maxColours || h.width <= 0 || h.height <= 0
+        || static_cast<uint64_t>(h.width) * static_cast<uint64_t>(h.height) > templateFormat::maxPixels) {
+        std::cerr << "Error: " << path << " is truncated or damaged" << std::endl;
+        return false;
+    }
+
+    // every section inside the file and aligned, so the arrays can be read in place
+    const uint64_t n = h.regions;
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset % 8 == 0 && offset <= length && count <= (length - offset) / size;
+    };
+    bool ok = fits(h.area, n, sizeof(double)) && fits(h.clusterLabel, n, sizeof(int32_t))
+           && fits(h.centroidX, n, sizeof(int32_t)) && fits(h.centroidY, n, sizeof(int32_t))
+           && fits(h.labelX, n, sizeof(int32_t)) && fits(h.labelY, n, sizeof(int32_t))
+           && fits(h.contourStart, n + 1, sizeof(uint64_t))
+           && fits(h.stepX, h.steps, sizeof(int16_t)) && fits(h.stepY, h.steps, sizeof(int16_t));
+    if (ok) {
+        // contour ranges in order and inside the step arrays, checked once so contour() doesn't have to
+        const uint64_t *start = section<uint64_t>(h.contourStart);
+        ok = start[0] == 0 && start[n] == h.steps;
+        for (uint64_t i = 0; ok && i < n; i++) ok = start[i] <= start[i + 1];
+    }
+    auto inside = [&](int64_t x, int64_t y) { return x >= 0 && y >= 0 && x < h.width && y < h.height; };
+    if (ok) {
+        const int32_t *labels = section<int32_t>(h.clusterLabel);
+        const int32_t *cx = section<int32_t>(h.centroidX), *cy = section<int32_t>(h.centroidY);
+        const int32_t *lx = section<int32_t>(h.labelX), *ly = section<int32_t>(h.labelY);
+        for (uint64_t i = 0; ok && i < n; i++) {
+            ok = labels[i] >= 0 && labels[i] < static_cast<int32_t>(h.clusters) && inside(cx[i], cy[i]) && inside(lx[i], ly[i]);
+        }
+    }
+    if (ok) {
+        // every contour point inside the image, which also keeps contour() free of overflow
+        const uint64_t *start = section<uint64_t>(h.contourStart);
+        const int16_t *stepX = section<int16_t>(h.stepX), *stepY = section<int16_t>(h.stepY);
+        for (uint64_t i = 0; ok && i < n; i++) {
+            int64_t x = 0, y = 0;
+            for (uint64_t s = start[i]; ok && s < start[i + 1]; s++) {
+                int64_t dx = stepX[s], dy = stepY[s];
+                if (dx == templateFormat::escape && dy == templateFormat::escape) {
+                    if (start[i + 1] - s < 3) {
+                        ok = false;
+                        break;
+                    }
+                    dx = static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(stepX[s + 1])) << 16) | static_cast<uint16_t>(stepY[s + 1]));
+                    dy = static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(stepX[s + 2])) << 16) | static_cast<uint16_t>(stepY[s + 2]));
+                    s += 2;
+                }
+                x += dx;
+                y += dy;
+                ok = inside(x, y);
+            }
+        }
+    }
+    if (!ok) {
+        std::cerr << "Error: " << path << " is truncated or damaged" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+const templateFormat::templateHeader& templateReader::header() const
+{
+    return *reinterpret_cast<const templateFormat::templateHeader*>(data);
+}
+
+template <typename T>
+const T* templateReader::section(uint64_t offset) const
+{
+    return reinterpret_cast<const T*>(data + offset);
+}
+
+cv::Size templateReader::getSize() const
+{
+    return data ? cv::Size(header().width, header().height) : cv::Size();
+}
+
+cv::Mat templateReader::getPalette() const
+{
+    if (!data) return cv::Mat();
+    const int clusters = static_cast<int>(header().clusters);
+    cv::Mat palette(clusters, 3, CV_8U);
+    for (int c = 0; c < clusters; c++) {
+        for (int ch = 0; ch < 3; ch++) palette.at<uchar>(c, ch) = header().palette[c][ch];
+    }
+    return palette;
+}
+
+int templateReader::regionCount() const
+{
+    return data ? static_cast<int>(header().regions) : 0;
+}
+
+const double* templateReader::areas() const
+{
+    return section<double>(header().area);
+}
+
+const int32_t* templateReader::clusterLabels() const
+{
+    return section<int32_t>(header().clusterLabel);
+}
+
+const int32_t* templateReader::centroidsX() const
+{
+    return section<int32_t>(header().centroidX);
+}
+
+const int32_t* templateReader::centroidsY() const
+{
+    return section<int32_t>(header().centroidY);
+}
+
+const int32_t* templateReader::labelsX() const
+{
+    return section<int32_t>(header().labelX);
+}
+
+const int32_t* templateReader::labelsY() const
+{
+    return section<int32_t>(header().labelY);
+}
+
+std::vector<cv::Point> templateReader::contour(int region) const
+{
+    const uint64_t *start = section<uint64_t>(header().contourStart);
+    const int16_t *stepX = section<int16_t>(header().stepX);
+    const int16_t *stepY = section<int16_t>(header().stepY);
+    const uint64_t end = start[region + 1];
+
+    std::vector<cv::Point> points;
+    points.reserve(end - start[region]);
+    cv::Point last(0, 0);
+    for (uint64_t s = start[region]; s < end; s++) {
+        int dx = stepX[s], dy = stepY[s];
+        if (dx == templateFormat::escape && dy == templateFormat::escape) {
+            if (end - s < 3) break; // escape cut short, damaged file
+            dx = static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(stepX[s + 1])) << 16) | static_cast<uint16_t>(stepY[s + 1]));
+            dy = static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(stepX[s + 2])) << 16) | static_cast<uint16_t>(stepY[s + 2]));
+            s += 2;
+        }
+        last += cv::Point(dx, dy);
+        points.push_back(last);
+    }
+    return points;
+}
+
+std::vector<regionInfo> templateReader::getRegions() const
+{
+    const int n = regionCount();
+    std::vector<regionInfo> regions(n);
+    if (n == 0) return regions;
+
+    const double *area = areas();
+    const int32_t *cluster = clusterLabels(), *cx = centroidsX(), *cy = centroidsY();
+    cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            regions[i].contour = contour(i);
+            regions[i].clusterLabel = cluster[i];
+            regions[i].centroid = cv::Point(cx[i], cy[i]);
+            regions[i].area = area[i];
+        }
+    });
+    return regions;
+}
+
+std::vector<cv::Point> templateReader::getLabelPositions() const
+{
+    const int n = regionCount();
+    std::vector<cv::Point> positions(n);
+    const int32_t *x = n ? labelsX() : nullptr, *y = n ? labelsY() : nullptr;
+    for (int i = 0; i < n; i++) positions[i] = cv::Point(x[i], y[i]);
+    return positions;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <opencv4/opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "regionInfo.hpp"
+#include "templateFormat.hpp"
+
+// Read side of a .cbt template file. The file is memory mapped and checked
+// once on open (header, section bounds, and every cluster, label and contour
+// point inside the image, one linear pass); after that the per-region arrays
+// are used in place, straight from the mapping, and a contour is only decoded
+// into points when asked for.
+class templateReader
+{
+    public:
+        templateReader() = default;
+        ~templateReader();
+        templateReader(const templateReader &) = delete;
+        templateReader& operator=(const templateReader &) = delete;
+
+        bool open(const std::string &path);
+        void close();
+
+        cv::Size getSize() const;
+        cv::Mat getPalette() const; // clusters x 3, CV_8U, BGR
+        int regionCount() const;
+
+        // Flat per-region arrays inside the mapping, regionCount() long
+        const double* areas() const;
+        const int32_t* clusterLabels() const;
+        const int32_t* centroidsX() const;
+        const int32_t* centroidsY() const;
+        const int32_t* labelsX() const;
+        const int32_t* labelsY() const;
+
+        std::vector<cv::Point> contour(int region) const;
+        std::vector<regionInfo> getRegions() const;          // everything decoded, same order as written
+        std::vector<cv::Point> getLabelPositions() const;
+
+    private:
+        const unsigned char *data = nullptr;
+        size_t length = 0;
+        std::vector<unsigned char> copy; // file contents where there is no mmap
+
+        const templateFormat::templateHeader& header() const;
+        template <typename T> const T* section(uint64_t offset) const;
+        bool validate(const std::string &path) const;
+};
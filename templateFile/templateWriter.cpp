@@ -0,0 +1,149 @@
+#include "templateWriter.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+uint64_t alignUp(uint64_t offset)
+{
+    return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+template <typename T>
+void writeSection(std::ofstream& out, uint64_t offset, const std::vector<T>& values)
+{
+    // zero padding up to the section start
+    static const char zeros[8] = {};
+    const uint64_t at = static_cast<uint64_t>(out.tellp());
+    out.write(zeros, static_cast<std::streamsize>(offset - at));
+    out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+} // namespace
+
+templateWriter::templateWriter(cv::Size size, const std::vector<regionInfo> &regions, const std::vector<cv::Point> &labelPositions,
+                               const cv::Mat &palette)
+{
+    std::memcpy(header.magic, templateFormat::magic, sizeof(header.magic));
+    header.version = templateFormat::version;
+    header.width = size.width;
+    header.height = size.height;
+
+    paletteRows = palette.rows;
+    header.clusters = static_cast<uint32_t>(std::min(palette.rows, templateFormat::maxColours));
+    for (int c = 0; c < static_cast<int>(header.clusters); c++) {
+        for (int ch = 0; ch < 3; ch++) header.palette[c][ch] = palette.at<uchar>(c, ch);
+    }
+
+    const size_t n = regions.size();
+    area.reserve(n);
+    clusterLabel.reserve(n);
+    centroidX.reserve(n);
+    centroidY.reserve(n);
+    labelX.reserve(n);
+    labelY.reserve(n);
+    contourStart.reserve(n + 1);
+    for (size_t i = 0; i < n; i++) {
+        const regionInfo& region = regions[i];
+        const cv::Point label = i < labelPositions.size() ? labelPositions[i] : region.centroid;
+        area.push_back(region.area);
+        clusterLabel.push_back(region.clusterLabel);
+        centroidX.push_back(region.centroid.x);
+        centroidY.push_back(region.centroid.y);
+        labelX.push_back(label.x);
+        labelY.push_back(label.y);
+
+        contourStart.push_back(stepX.size());
+        cv::Point last(0, 0);
+        for (const auto& point : region.contour) {
+            addStep(point.x - last.x, point.y - last.y);
+            last = point;
+        }
+    }
+    contourStart.push_back(stepX.size());
+
+    header.regions = static_cast<uint32_t>(n);
+    header.steps = stepX.size();
+    layout();
+}
+
+void templateWriter::addStep(int dx, int dy)
+{
+    // escape is reserved, so a plain step is -32767..32767
+    if (dx > INT16_MIN && dx <= INT16_MAX && dy > INT16_MIN && dy <= INT16_MAX) {
+        stepX.push_back(static_cast<int16_t>(dx));
+        stepY.push_back(static_cast<int16_t>(dy));
+        return;
+    }
+    const uint32_t ux = static_cast<uint32_t>(dx), uy = static_cast<uint32_t>(dy);
+    stepX.push_back(templateFormat::escape);
+    stepY.push_back(templateFormat::escape);
+    stepX.push_back(static_cast<int16_t>(ux >> 16));
+    stepY.push_back(static_cast<int16_t>(ux & 0xffff));
+    stepX.push_back(static_cast<int16_t>(uy >> 16));
+    stepY.push_back(static_cast<int16_t>(uy & 0xffff));
+}
+
+void templateWriter::layout()
+{
+    uint64_t offset = sizeof(templateFormat::templateHeader);
+    auto place = [&](uint64_t& section, uint64_t bytes) {
+        section = alignUp(offset);
+        offset = section + bytes;
+    };
+    const uint64_t n = header.regions;
+    place(header.area, n * sizeof(double));
+    place(header.clusterLabel, n * sizeof(int32_t));
+    place(header.centroidX, n * sizeof(int32_t));
+    place(header.centroidY, n * sizeof(int32_t));
+    place(header.labelX, n * sizeof(int32_t));
+    place(header.labelY, n * sizeof(int32_t));
+    place(header.contourStart, (n + 1) * sizeof(uint64_t));
+    place(header.stepX, header.steps * sizeof(int16_t));
+    place(header.stepY, header.steps * sizeof(int16_t));
+    header.fileSize = offset;
+}
+
+bool templateWriter::write(const std::string &path) const
+{
+    if (!templateFormat::littleEndianHost()) {
+        std::cerr << "Error: Template files can only be written on little endian machines" << std::endl;
+        return false;
+    }
+    if (header.width <= 0 || header.height <= 0
+        || static_cast<uint64_t>(header.width) * static_cast<uint64_t>(header.height) > templateFormat::maxPixels) {
+        std::cerr << "Error: Template files hold images of at most " << templateFormat::maxPixels << " pixels" << std::endl;
+        return false;
+    }
+    if (paletteRows > templateFormat::maxColours) {
+        std::cerr << "Error: Template files hold at most " << templateFormat::maxColours << " colours" << std::endl;
+        return false;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Error: Could not write " << path << std::endl;
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(out, header.area, area);
+    writeSection(out, header.clusterLabel, clusterLabel);
+    writeSection(out, header.centroidX, centroidX);
+    writeSection(out, header.centroidY, centroidY);
+    writeSection(out, header.labelX, labelX);
+    writeSection(out, header.labelY, labelY);
+    writeSection(out, header.contourStart, contourStart);
+    writeSection(out, header.stepX, stepX);
+    writeSection(out, header.stepY, stepY);
+
+    if (!out)
+    {
+        std::cerr << "Error: Could not write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <opencv4/opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "regionInfo.hpp"
+#include "templateFormat.hpp"
+
+// Saves a finished template (regions, label poles, palette) as a .cbt file,
+// see templateFormat.hpp, so it can be shown or exported later, or on another
+// machine, without running the pipeline again.
+class templateWriter
+{
+    public:
+        templateWriter(cv::Size size, const std::vector<regionInfo> &regions, const std::vector<cv::Point> &labelPositions,
+                       const cv::Mat &palette);
+        bool write(const std::string &path) const;
+
+    private:
+        templateFormat::templateHeader header{};
+        std::vector<double> area;
+        std::vector<int32_t> clusterLabel, centroidX, centroidY, labelX, labelY;
+        std::vector<uint64_t> contourStart;
+        std::vector<int16_t> stepX, stepY;
+        int paletteRows = 0;
+
+        void addStep(int dx, int dy);
+        void layout();
+};
@@ -0,0 +1,616 @@
+#include "tiledProcess.hpp"
+#include "quantizer/fastQuantizer.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <deque>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+inline int binIndex(const uchar* px)
+{
+    return ((px[0] >> 3) << 10) | ((px[1] >> 3) << 5) | (px[2] >> 3);
+}
+
+inline uint64_t pairKey(int a, int b)
+{
+    return (static_cast<uint64_t>(std::min(a, b)) << 32) | static_cast<uint32_t>(std::max(a, b));
+}
+
+// Next PPM header field, skipping whitespace and # comments
+bool ppmToken(std::istream& in, std::string& token)
+{
+    token.clear();
+    int c;
+    while ((c = in.get()) != EOF) {
+        if (c == '#') {
+            while ((c = in.get()) != EOF && c != '\n') {}
+        } else if (!std::isspace(c)) {
+            token.push_back(static_cast<char>(c));
+            break;
+        }
+    }
+    while ((c = in.peek()) != EOF && !std::isspace(c) && c != '#') {
+        token.push_back(static_cast<char>(in.get()));
+    }
+    return !token.empty();
+}
+
+} // namespace
+
+tiledProcess::tiledProcess(const std::string &inputPath, int clusters, const tiledProcessOptions &opts)
+    : inputPath(inputPath), clusters(clusters), opts(opts)
+{
+    this->opts.stripRows = std::max(1, opts.stripRows);
+    this->opts.poleRadius = std::max(1, std::min(opts.poleRadius, this->opts.stripRows));
+}
+
+tiledProcess::~tiledProcess()
+{
+    if (spill) std::fclose(spill); // tmpfile is removed on close
+}
+
+bool tiledProcess::run(const std::string &outputPath)
+{
+    if (clusters < 1 || clusters > 255)
+    {
+        std::cerr << "Error: Tiled mode stores labels as uint8 and supports at most 255 colours" << std::endl;
+        return false;
+    }
+    if (!openInput()) return false;
+    if (!learnPalette()) return false;
+    if (!labelStrips()) return false;
+    if (profiler) {
+        profiler->count("strips", stripCount());
+        profiler->count("regionsKept", static_cast<double>(regions.size()));
+    }
+    if (!placePoles()) return false;
+    return render(outputPath);
+}
+
+const cv::Mat& tiledProcess::getPalette() const
+{
+    return centre;
+}
+
+void tiledProcess::setProfiler(stageProfiler *profiler)
+{
+    this->profiler = profiler;
+}
+
+bool tiledProcess::openInput()
+{
+    ppm.open(inputPath, std::ios::binary);
+    std::string magic, w, h, maxval;
+    if (ppm && ppmToken(ppm, magic) && magic == "P6" && ppmToken(ppm, w) && ppmToken(ppm, h)
+        && ppmToken(ppm, maxval) && maxval == "255")
+    {
+        try {
+            width = std::stoi(w);
+            height = std::stoi(h);
+        } catch (const std::exception&) {
+            width = height = 0;
+        }
+        ppm.get(); // the single whitespace before the pixels
+        ppmData = ppm.tellg();
+        if (width > 0 && height > 0) return true;
+    }
+    ppm.close();
+
+    std::cerr << "Warning: " << inputPath << " is not an 8 bit binary PPM, decoding it whole (memory is not bounded by the strip size)" << std::endl;
+    decoded = cv::imread(inputPath, cv::IMREAD_COLOR);
+    if (decoded.empty())
+    {
+        std::cerr << "Error: Could not load image from: " << inputPath << std::endl;
+        return false;
+    }
+    width = decoded.cols;
+    height = decoded.rows;
+    return true;
+}
+
+bool tiledProcess::rewindInput()
+{
+    nextRow = 0;
+    if (!decoded.empty()) return true;
+    ppm.clear();
+    ppm.seekg(ppmData);
+    return static_cast<bool>(ppm);
+}
+
+bool tiledProcess::readStrip(int rows, cv::Mat &strip)
+{
+    if (!decoded.empty()) {
+        strip = decoded.rowRange(nextRow, nextRow + rows);
+    } else {
+        cv::Mat rgb(rows, width, CV_8UC3);
+        if (!ppm.read(reinterpret_cast<char*>(rgb.data), static_cast<std::streamsize>(rgb.total() * rgb.elemSize())))
+        {
+            std::cerr << "Error: " << inputPath << " ends before row " << nextRow + rows << std::endl;
+            return false;
+        }
+        cv::cvtColor(rgb, strip, cv::COLOR_RGB2BGR);
+    }
+    nextRow += rows;
+    return true;
+}
+
+bool tiledProcess::learnPalette()
+{
+    stageTimer timer(profiler, "tiledPalette");
+    if (!rewindInput()) return false;
+
+    // Same 5 bit per channel histogram as histogramQuantizer, filled strip by strip
+    constexpr int bins = 1 << 15;
+    std::vector<std::array<uint64_t, 3>> sums(bins, {0, 0, 0});
+    std::vector<uint64_t> counts(bins, 0);
+
+    cv::Mat strip;
+    for (int s = 0; s < stripCount(); s++) {
+        if (!readStrip(stripHeight(s), strip)) return false;
+        for (int y = 0; y < strip.rows; y++) {
+            const uchar* px = strip.ptr(y);
+            for (int x = 0; x < strip.cols; x++, px += 3) {
+                int bin = binIndex(px);
+                sums[bin][0] += px[0];
+                sums[bin][1] += px[1];
+                sums[bin][2] += px[2];
+                counts[bin]++;
+            }
+        }
+    }
+
+    std::vector<cv::Vec3f> colours;
+    std::vector<float> weights;
+    std::vector<int> binEntry(bins, -1);
+    for (int bin = 0; bin < bins; bin++) {
+        if (counts[bin] == 0) continue;
+        double n = static_cast<double>(counts[bin]);
+        binEntry[bin] = static_cast<int>(colours.size());
+        colours.emplace_back(static_cast<float>(sums[bin][0] / n), static_cast<float>(sums[bin][1] / n), static_cast<float>(sums[bin][2] / n));
+        weights.push_back(static_cast<float>(n));
+    }
+
+    fastQuantizer engine;
+    std::vector<cv::Vec3f> palette;
+    if (!engine.fitPalette(colours, weights, clusters, palette)) return false;
+
+    std::vector<int> entryLabel;
+    fastQuantizer::nearestCentres(colours, palette, entryLabel);
+    binLabel.assign(bins, 0);
+    for (int bin = 0; bin < bins; bin++) {
+        if (binEntry[bin] >= 0) binLabel[bin] = static_cast<uchar>(entryLabel[binEntry[bin]]);
+    }
+
+    centre.create(clusters, 3, CV_8U);
+    for (int c = 0; c < clusters; c++) {
+        for (int ch = 0; ch < 3; ch++) {
+            centre.at<uchar>(c, ch) = cv::saturate_cast<uchar>(palette[c][ch]);
+        }
+    }
+    return true;
+}
+
+bool tiledProcess::labelStrips()
+{
+    stageTimer timer(profiler, "tiledLabels");
+    if (!rewindInput()) return false;
+    spill = std::tmpfile();
+    if (!spill)
+    {
+        std::cerr << "Error: Could not create a temporary file for the label map" << std::endl;
+        return false;
+    }
+
+    // Components are found per strip and joined across seams, every strip
+    // component gets a provisional id in one union-find
+    std::vector<int> parent;
+    std::vector<regionStats> provisional;
+    // pixel edges between components, only kept where a side may end up below minRegionArea
+    std::unordered_map<uint64_t, int> contacts;
+    const bool mergeSmall = opts.minRegionArea > 1;
+    auto touch = [&](int a, int b) {
+        if (provisional[a].area < opts.minRegionArea || provisional[b].area < opts.minRegionArea) contacts[pairKey(a, b)]++;
+    };
+
+    cv::Mat strip, labels;
+    std::vector<int> ids;
+    std::vector<uchar> prevLabels(width);
+    std::vector<int> prevIds(width);
+    int offset = 0;
+
+    for (int s = 0; s < stripCount(); s++) {
+        const int rows = stripHeight(s);
+        const int top = s * opts.stripRows;
+        if (!readStrip(rows, strip)) return false;
+
+        labels.create(rows, width, CV_8U);
+        for (int y = 0; y < rows; y++) {
+            const uchar* px = strip.ptr(y);
+            uchar* dst = labels.ptr(y);
+            for (int x = 0; x < width; x++, px += 3) dst[x] = binLabel[binIndex(px)];
+        }
+        if (std::fwrite(labels.data, 1, labels.total(), spill) != labels.total())
+        {
+            std::cerr << "Error: Could not write the temporary label map" << std::endl;
+            return false;
+        }
+
+        const int count = labelStrip(labels, ids);
+        stripOffsets.push_back(offset);
+        parent.resize(offset + count);
+        std::iota(parent.begin() + offset, parent.end(), offset);
+        provisional.resize(offset + count);
+
+        const uchar* label = labels.ptr();
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < width; x++) {
+                const size_t i = static_cast<size_t>(y) * width + x;
+                auto& stats = provisional[offset + ids[i]];
+                stats.area += 1;
+                stats.sumX += x;
+                stats.sumY += top + y;
+                stats.cluster = label[i];
+            }
+        }
+
+        if (mergeSmall) {
+            for (int y = 0; y < rows; y++) {
+                for (int x = 0; x < width; x++) {
+                    const size_t i = static_cast<size_t>(y) * width + x;
+                    if (x + 1 < width && label[i] != label[i + 1]) touch(offset + ids[i], offset + ids[i + 1]);
+                    if (y + 1 < rows && label[i] != label[i + width]) touch(offset + ids[i], offset + ids[i + width]);
+                }
+            }
+        }
+
+        // seam with the last row of the previous strip
+        if (s > 0) {
+            for (int x = 0; x < width; x++) {
+                const int a = prevIds[x], b = offset + ids[x];
+                if (prevLabels[x] == label[x]) {
+                    int ra = find(parent, a), rb = find(parent, b);
+                    if (ra != rb) parent[std::max(ra, rb)] = std::min(ra, rb);
+                } else if (mergeSmall) {
+                    touch(a, b);
+                }
+            }
+        }
+        const size_t last = static_cast<size_t>(rows - 1) * width;
+        for (int x = 0; x < width; x++) {
+            prevLabels[x] = label[last + x];
+            prevIds[x] = offset + ids[last + x];
+        }
+        offset += count;
+    }
+
+    // Roots come first in id order, so their stats are complete before anything is added on
+    const int n = offset;
+    if (profiler) profiler->count("stripComponents", n); // what the region bookkeeping scales with
+    std::vector<int> root(n);
+    for (int i = 0; i < n; i++) {
+        root[i] = find(parent, i);
+        if (root[i] == i) continue;
+        provisional[root[i]].area += provisional[i].area;
+        provisional[root[i]].sumX += provisional[i].sumX;
+        provisional[root[i]].sumY += provisional[i].sumY;
+    }
+    parent.clear();
+    parent.shrink_to_fit();
+
+    // Small components go to the neighbour they share the longest border with,
+    // smallest first, the same rule componentRegions uses
+    std::vector<int> mergeParent(n);
+    std::iota(mergeParent.begin(), mergeParent.end(), 0);
+    if (mergeSmall) {
+        std::unordered_map<uint64_t, int> rootContacts;
+        for (const auto& contact : contacts) {
+            int a = root[static_cast<int>(contact.first >> 32)], b = root[static_cast<int>(contact.first & 0xffffffffu)];
+            if (a != b) rootContacts[pairKey(a, b)] += contact.second;
+        }
+        contacts.clear();
+
+        struct neighbourRun { int small, neighbour, shared; };
+        std::vector<neighbourRun> runs;
+        for (const auto& contact : rootContacts) {
+            int a = static_cast<int>(contact.first >> 32), b = static_cast<int>(contact.first & 0xffffffffu);
+            if (provisional[a].area < opts.minRegionArea) runs.push_back({a, b, contact.second});
+            if (provisional[b].area < opts.minRegionArea) runs.push_back({b, a, contact.second});
+        }
+        rootContacts.clear();
+        std::sort(runs.begin(), runs.end(), [](const neighbourRun& x, const neighbourRun& y) {
+            return x.small != y.small ? x.small < y.small : x.neighbour < y.neighbour;
+        });
+
+        std::vector<int> small;
+        for (int i = 0; i < n; i++) {
+            if (root[i] == i && provisional[i].area < opts.minRegionArea) small.push_back(i);
+        }
+        std::stable_sort(small.begin(), small.end(), [&](int a, int b) { return provisional[a].area < provisional[b].area; });
+
+        std::vector<double> merged(n);
+        for (int i = 0; i < n; i++) merged[i] = provisional[i].area;
+
+        for (int id : small) {
+            int self = find(mergeParent, id);
+            if (merged[self] >= opts.minRegionArea) continue; // already grown past the threshold
+            auto run = std::lower_bound(runs.begin(), runs.end(), id, [](const neighbourRun& r, int value) { return r.small < value; });
+            int best = -1, bestShared = 0;
+            for (; run != runs.end() && run->small == id; ++run) {
+                if (run->shared > bestShared && find(mergeParent, run->neighbour) != self) {
+                    best = run->neighbour;
+                    bestShared = run->shared;
+                }
+            }
+            if (best < 0) continue;
+            int target = find(mergeParent, best);
+            mergeParent[self] = target;
+            merged[target] += merged[self];
+        }
+    }
+
+    // Final regions, coloured like the component they were merged into
+    std::vector<int> compact(n, -1);
+    regions.clear();
+    regionOf.assign(n, 0);
+    for (int i = 0; i < n; i++) {
+        int r = find(mergeParent, root[i]);
+        if (compact[r] < 0) {
+            compact[r] = static_cast<int>(regions.size());
+            regions.emplace_back();
+            regions.back().cluster = provisional[r].cluster;
+        }
+        regionOf[i] = compact[r];
+        if (root[i] == i) {
+            auto& region = regions[regionOf[i]];
+            region.area += provisional[i].area;
+            region.sumX += provisional[i].sumX;
+            region.sumY += provisional[i].sumY;
+        }
+    }
+    return true;
+}
+
+bool tiledProcess::placePoles()
+{
+    stageTimer timer(profiler, "tiledPoles");
+    const int halo = opts.poleRadius;
+    const float cap = static_cast<float>(halo);
+
+    // A pixel's distance to the nearest border is exact up to the halo, so every
+    // region whose inscribed circle fits in it gets its true pole; bigger ones
+    // take the capped pixel closest to their centroid
+    return sweepWindows(halo, [&](const cv::Mat &ids, int top, int coreBegin, int coreEnd) {
+        cv::Mat mask = borderMask(ids);
+        mask.col(0).setTo(255);
+        mask.col(mask.cols - 1).setTo(255);
+        if (top == 0) mask.row(0).setTo(255);
+        if (top + ids.rows == height) mask.row(ids.rows - 1).setTo(255);
+
+        cv::Mat inside, dist;
+        cv::bitwise_not(mask, inside);
+        // the 3x3 mask only approximates L2, the precise one keeps the poles exact
+        cv::distanceTransform(inside, dist, cv::DIST_L2, cv::DIST_MASK_PRECISE);
+
+        for (int y = coreBegin; y < coreEnd; y++) {
+            const int* row = ids.ptr<int>(y);
+            const float* d = dist.ptr<float>(y);
+            for (int x = 0; x < ids.cols; x++) {
+                auto& region = regions[row[x]];
+                const float value = std::min(d[x], cap);
+                if (value < region.poleDist) continue;
+                const double dx = x - region.sumX / region.area, dy = top + y - region.sumY / region.area;
+                const double centreDist = dx * dx + dy * dy;
+                if (value > region.poleDist || centreDist < region.poleCentreDist) {
+                    region.poleDist = value;
+                    region.poleCentreDist = centreDist;
+                    region.pole = cv::Point(x, top + y);
+                }
+            }
+        }
+    });
+}
+
+bool tiledProcess::render(const std::string &outputPath)
+{
+    stageTimer timer(profiler, "tiledRender");
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Error: Could not write " << outputPath << std::endl;
+        return false;
+    }
+    out << "P5\n" << width << " " << height << "\n255\n";
+
+    // Same font and placement as imageProcess::labelRegions
+    const int fontFace = cv::FONT_HERSHEY_PLAIN;
+    const double fontScale = 1;
+    const int thickness = 1;
+
+    struct placedLabel {
+        cv::Point origin;
+        int cluster;
+    };
+    std::vector<std::string> labelTexts(clusters);
+    std::vector<cv::Size> textSizes(clusters);
+    int reach = 0;
+    for (int cluster = 0; cluster < clusters; cluster++) {
+        int baseline = 0;
+        labelTexts[cluster] = std::to_string(cluster);
+        textSizes[cluster] = cv::getTextSize(labelTexts[cluster], fontFace, fontScale, thickness, &baseline);
+        reach = std::max(reach, textSizes[cluster].height + baseline + 2);
+    }
+
+    std::vector<placedLabel> labels;
+    labels.reserve(regions.size());
+    for (const auto& region : regions) {
+        const cv::Size& textSize = textSizes[region.cluster];
+        int textX = std::max(0, std::min(width - textSize.width, region.pole.x - textSize.width / 2));
+        int textY = std::max(textSize.height, std::min(height, region.pole.y + textSize.height / 2));
+        labels.push_back({cv::Point(textX, textY), region.cluster});
+    }
+    std::sort(labels.begin(), labels.end(), [](const placedLabel& a, const placedLabel& b) { return a.origin.y < b.origin.y; });
+
+    // Strips are written as soon as they are drawn, text crossing a seam is
+    // drawn into both strips and clipped by each
+    size_t first = 0;
+    bool ok = sweepWindows(1, [&](const cv::Mat &ids, int top, int coreBegin, int coreEnd) {
+        cv::Mat mask = borderMask(ids);
+        cv::Mat strip(coreEnd - coreBegin, ids.cols, CV_8U, cv::Scalar(255));
+        strip.setTo(cv::Scalar(0), mask.rowRange(coreBegin, coreEnd));
+
+        const int stripTop = top + coreBegin;
+        const int stripBottom = stripTop + strip.rows;
+        while (first < labels.size() && labels[first].origin.y + reach < stripTop) first++;
+        for (size_t i = first; i < labels.size() && labels[i].origin.y - reach < stripBottom; i++) {
+            cv::putText(strip, labelTexts[labels[i].cluster], labels[i].origin - cv::Point(0, stripTop),
+                    fontFace, fontScale, cv::Scalar(0), thickness, cv::LINE_AA);
+        }
+        out.write(reinterpret_cast<const char*>(strip.data), static_cast<std::streamsize>(strip.total()));
+    });
+
+    if (!ok || !out)
+    {
+        std::cerr << "Error: Could not write " << outputPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int tiledProcess::stripCount() const
+{
+    return (height + opts.stripRows - 1) / opts.stripRows;
+}
+
+int tiledProcess::stripHeight(int strip) const
+{
+    return std::min(opts.stripRows, height - strip * opts.stripRows);
+}
+
+bool tiledProcess::readRegionStrip(int strip, cv::Mat &ids)
+{
+    cv::Mat labels(stripHeight(strip), width, CV_8U);
+    if (std::fread(labels.data, 1, labels.total(), spill) != labels.total())
+    {
+        std::cerr << "Error: Could not read back the temporary label map" << std::endl;
+        return false;
+    }
+
+    // Relabelling the strip gives the same provisional ids as labelStrips did
+    std::vector<int> local;
+    labelStrip(labels, local);
+    ids.create(labels.size(), CV_32S);
+    int* dst = ids.ptr<int>();
+    const int offset = stripOffsets[strip];
+    for (size_t i = 0; i < local.size(); i++) dst[i] = regionOf[offset + local[i]];
+    return true;
+}
+
+bool tiledProcess::sweepWindows(int halo, const std::function<void(const cv::Mat &window, int windowTop, int coreBegin, int coreEnd)> &visit)
+{
+    std::rewind(spill);
+
+    // Final region ids of the previous, current and next strip; each strip is
+    // visited with up to halo rows of its neighbours around it
+    std::deque<cv::Mat> window;
+    int visited = 0;
+    auto visitStrip = [&](size_t core) {
+        std::vector<cv::Mat> parts;
+        int above = 0;
+        if (core > 0) {
+            const cv::Mat& prev = window[core - 1];
+            above = std::min(halo, prev.rows);
+            parts.push_back(prev.rowRange(prev.rows - above, prev.rows));
+        }
+        parts.push_back(window[core]);
+        if (core + 1 < window.size()) {
+            const cv::Mat& next = window[core + 1];
+            parts.push_back(next.rowRange(0, std::min(halo, next.rows)));
+        }
+        cv::Mat joined;
+        cv::vconcat(parts, joined);
+        visit(joined, visited * opts.stripRows - above, above, above + window[core].rows);
+        visited++;
+    };
+
+    for (int s = 0; s < stripCount(); s++) {
+        cv::Mat ids;
+        if (!readRegionStrip(s, ids)) return false;
+        window.push_back(ids);
+        if (window.size() > 3) window.pop_front();
+        if (s > 0) visitStrip(window.size() - 2);
+    }
+    if (!window.empty()) visitStrip(window.size() - 1);
+    return true;
+}
+
+int tiledProcess::labelStrip(const cv::Mat &labels, std::vector<int> &ids)
+{
+    // 4-connected components of equal labels, as in componentRegions::labelComponents
+    const int cols = labels.cols, rows = labels.rows;
+    ids.assign(static_cast<size_t>(cols) * rows, 0);
+    std::vector<int> parent;
+    parent.reserve(1024);
+
+    for (int y = 0; y < rows; y++) {
+        const uchar* row = labels.ptr(y);
+        int* idRow = ids.data() + static_cast<size_t>(y) * cols;
+        for (int x = 0; x < cols; x++) {
+            const bool joinLeft = x > 0 && row[x - 1] == row[x];
+            const bool joinUp = y > 0 && row[x - cols] == row[x];
+            if (joinLeft) {
+                idRow[x] = idRow[x - 1];
+                if (joinUp) {
+                    int a = find(parent, idRow[x - 1]), b = find(parent, idRow[x - cols]);
+                    if (a != b) parent[std::max(a, b)] = std::min(a, b);
+                }
+            } else if (joinUp) {
+                idRow[x] = idRow[x - cols];
+            } else {
+                idRow[x] = static_cast<int>(parent.size());
+                parent.push_back(idRow[x]);
+            }
+        }
+    }
+
+    std::vector<int> compact(parent.size(), -1);
+    int count = 0;
+    for (size_t i = 0; i < parent.size(); i++) {
+        int root = find(parent, static_cast<int>(i));
+        if (compact[root] < 0) compact[root] = count++;
+        compact[i] = compact[root];
+    }
+    for (auto& id : ids) id = compact[id];
+    return count;
+}
+
+cv::Mat tiledProcess::borderMask(const cv::Mat &ids)
+{
+    // both pixels of every edge between two regions, a 2 px line like drawBorders
+    cv::Mat mask = cv::Mat::zeros(ids.size(), CV_8U);
+    const int cols = ids.cols;
+    for (int y = 0; y < ids.rows; y++) {
+        const int* row = ids.ptr<int>(y);
+        uchar* m = mask.ptr(y);
+        for (int x = 0; x < cols; x++) {
+            if (x + 1 < cols && row[x] != row[x + 1]) m[x] = m[x + 1] = 255;
+            if (y + 1 < ids.rows && row[x] != row[x + cols]) {
+                m[x] = 255;
+                m[x + cols] = 255;
+            }
+        }
+    }
+    return mask;
+}
+
+int tiledProcess::find(std::vector<int> &parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <opencv4/opencv2/opencv.hpp>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "profiler/stageProfiler.hpp"
+
+struct tiledProcessOptions {
+    int stripRows = 256;        // image rows held in memory at once
+    int minRegionArea = 50;     // regions smaller than this are merged into a neighbour
+    int poleRadius = 32;        // label poles are exact up to this distance from a border, capped at stripRows
+};
+
+// Out-of-core template for images too large to hold in memory (mural and
+// poster scans). The image is streamed in full-width strips, several times:
+//   1. palette: binned colour histogram of every pixel, clustered like histogramQuantizer
+//   2. labels: uint8 cluster per pixel spilled to a temp file, connected components
+//      per strip, joined across strip seams with a union-find over strip components
+//   3. poles: region borders with a halo of poleRadius rows, exact Euclidean distance transform per strip
+//   4. render: borders and numbers drawn strip by strip straight into the output file
+// Pixel data in memory scales with stripRows * width, not with the image. The
+// region bookkeeping does not: union-find, stats and merge state take around
+// 100 bytes per strip component (before small ones are merged), plus an entry
+// per pair of touching components where one side is small. That is small for
+// scans with flat areas, but a noisy photo can have components on the order of
+// its pixel count, and then memory grows with the image again.
+// Input is streamed from binary PPM (P6); other formats are decoded whole with
+// imread. Output is a greyscale PGM (P5).
+class tiledProcess
+{
+    public:
+        tiledProcess(const std::string &inputPath, int clusters, const tiledProcessOptions &opts = tiledProcessOptions());
+        ~tiledProcess();
+        bool run(const std::string &outputPath);
+        const cv::Mat& getPalette() const; // clusters x 3, CV_8U, BGR
+        void setProfiler(stageProfiler *profiler); // null turns profiling off
+
+    private:
+        struct regionStats {
+            double area = 0, sumX = 0, sumY = 0;
+            int cluster = 0;
+            float poleDist = -1;        // capped distance to the nearest border
+            double poleCentreDist = 0;  // tie break between capped poles, closer to the centroid wins
+            cv::Point pole;
+        };
+
+        std::string inputPath;
+        int clusters;
+        tiledProcessOptions opts;
+        stageProfiler *profiler = nullptr;
+
+        // streamed input
+        std::ifstream ppm;
+        std::streampos ppmData;
+        cv::Mat decoded; // whole image, only when the input isn't a PPM
+        int width = 0, height = 0;
+        int nextRow = 0;
+
+        cv::Mat centre;
+        std::vector<uchar> binLabel;   // cluster of every 5 bit per channel colour bin
+        std::FILE *spill = nullptr;    // uint8 label map, one strip after the other
+        std::vector<int> stripOffsets; // first provisional component id of every strip
+        std::vector<int> regionOf;     // provisional component -> final region
+        std::vector<regionStats> regions;
+
+        bool openInput();
+        bool rewindInput();
+        bool readStrip(int rows, cv::Mat &strip);
+
+        bool learnPalette();
+        bool labelStrips();
+        bool placePoles();
+        bool render(const std::string &outputPath);
+
+        int stripCount() const;
+        int stripHeight(int strip) const;
+        bool readRegionStrip(int strip, cv::Mat &ids);
+        bool sweepWindows(int halo, const std::function<void(const cv::Mat &window, int windowTop, int coreBegin, int coreEnd)> &visit);
+
+        static int labelStrip(const cv::Mat &labels, std::vector<int> &ids);
+        static cv::Mat borderMask(const cv::Mat &ids);
+        static int find(std::vector<int> &parent, int i);
+};
@@ -0,0 +1,352 @@
+#include "vectorExport.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace {
+
+// crack directions around a pixel-corner vertex
+enum : uint8_t { RIGHT = 1, DOWN = 2, LEFT = 4, UP = 8 };
+
+const int legendSwatch = 20;
+const int legendSpacing = 50;
+const int legendRow = 30;
+
+uint8_t opposite(uint8_t bit)
+{
+    switch (bit) {
+        case RIGHT: return LEFT;
+        case LEFT: return RIGHT;
+        case DOWN: return UP;
+        default: return DOWN;
+    }
+}
+
+cv::Point step(uint8_t bit)
+{
+    switch (bit) {
+        case RIGHT: return {1, 0};
+        case LEFT: return {-1, 0};
+        case DOWN: return {0, 1};
+        default: return {0, -1};
+    }
+}
+
+uint8_t lowestBit(uint8_t mask)
+{
+    return mask & static_cast<uint8_t>(-mask);
+}
+
+int bitCount(uint8_t mask)
+{
+    int count = 0;
+    for (; mask; mask &= mask - 1) count++;
+    return count;
+}
+
+std::string hexColour(const cv::Vec3b& bgr)
+{
+    char buf[8];
+    std::snprintf(buf, sizeof(buf), "#%02x%02x%02x", bgr[2], bgr[1], bgr[0]);
+    return buf;
+}
+
+void writePath(std::ostream& out, const std::vector<cv::Point>& points, bool closed)
+{
+    out << "M" << points[0].x << " " << points[0].y;
+    for (size_t i = 1; i < points.size(); i++) {
+        out << "L" << points[i].x << " " << points[i].y;
+    }
+    if (closed) out << "Z";
+}
+
+} // namespace
+
+vectorExport::vectorExport(cv::Size size, const std::vector<regionInfo> &regions, const std::vector<cv::Point> &labelPositions,
+                           const cv::Mat &palette, const vectorExportOptions &opts)
+    : size(size), opts(opts)
+{
+    outlines.reserve(regions.size());
+    for (size_t i = 0; i < regions.size(); i++) {
+        const auto& region = regions[i];
+        std::vector<cv::Point> outline;
+        if (opts.tolerance > 0 && region.contour.size() > 2) {
+            cv::approxPolyDP(region.contour, outline, opts.tolerance, true);
+        } else {
+            outline = region.contour;
+        }
+        outlines.push_back(std::move(outline));
+        this->labelPositions.push_back(i < labelPositions.size() ? labelPositions[i] : region.centroid);
+        labelClusters.push_back(region.clusterLabel);
+    }
+
+    cv::Mat palette8U;
+    palette.convertTo(palette8U, CV_8U);
+    for (int c = 0; c < palette8U.rows && palette8U.cols * palette8U.channels() >= 3; c++) {
+        const uchar* row = palette8U.ptr(c);
+        colours.emplace_back(row[0], row[1], row[2]);
+    }
+
+    buildBorders(regions);
+}
+
+void vectorExport::buildBorders(const std::vector<regionInfo> &regions)
+{
+    const int width = size.width, height = size.height;
+    if (width <= 0 || height <= 0) return;
+
+    // Region id per pixel, largest regions first so nested ones end up on top
+    std::vector<size_t> order(regions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return regions[a].area > regions[b].area; });
+
+    cv::Mat ids(size, CV_32S, cv::Scalar(-1));
+    for (size_t i : order) {
+        if (regions[i].contour.size() < 3) continue;
+        cv::fillPoly(ids, regions[i].contour, cv::Scalar(static_cast<double>(i)));
+    }
+
+    // Uncovered pixels (e.g. the edge band between contours) join a neighbouring region
+    for (int y = 0; y < height; y++) {
+        int* row = ids.ptr<int>(y);
+        for (int x = 0; x < width; x++) {
+            if (row[x] >= 0) continue;
+            if (x > 0 && row[x - 1] >= 0) row[x] = row[x - 1];
+            else if (y > 0 && ids.ptr<int>(y - 1)[x] >= 0) row[x] = ids.ptr<int>(y - 1)[x];
+        }
+    }
+    for (int y = height - 1; y >= 0; y--) {
+        int* row = ids.ptr<int>(y);
+        for (int x = width - 1; x >= 0; x--) {
+            if (row[x] >= 0) continue;
+            if (x + 1 < width && row[x + 1] >= 0) row[x] = row[x + 1];
+            else if (y + 1 < height && ids.ptr<int>(y + 1)[x] >= 0) row[x] = ids.ptr<int>(y + 1)[x];
+        }
+    }
+
+    // Cracks between pixels of different regions, stored on the pixel-corner grid
+    const int stride = width + 1;
+    std::vector<uint8_t> cracks(static_cast<size_t>(stride) * (height + 1), 0);
+    auto vertex = [stride](int x, int y) { return static_cast<size_t>(y) * stride + x; };
+    for (int y = 0; y < height; y++) {
+        const int* row = ids.ptr<int>(y);
+        const int* below = y + 1 < height ? ids.ptr<int>(y + 1) : nullptr;
+        for (int x = 0; x < width; x++) {
+            if (x + 1 < width && row[x] != row[x + 1]) {
+                cracks[vertex(x + 1, y)] |= DOWN;
+                cracks[vertex(x + 1, y + 1)] |= UP;
+            }
+            if (below && row[x] != below[x]) {
+                cracks[vertex(x, y + 1)] |= RIGHT;
+                cracks[vertex(x + 1, y + 1)] |= LEFT;
+            }
+        }
+    }
+    ids.release();
+
+    std::vector<uint8_t> degree(cracks.size());
+    for (size_t v = 0; v < cracks.size(); v++) degree[v] = static_cast<uint8_t>(bitCount(cracks[v]));
+
+    // Walk from a vertex along a crack until the next junction (or back to the start)
+    auto follow = [&](int x, int y, uint8_t bit) {
+        std::vector<cv::Point> chain{cv::Point(x, y)};
+        const cv::Point start(x, y);
+        cv::Point current = start;
+        uint8_t lastBit = 0;
+        while (bit) {
+            cracks[vertex(current.x, current.y)] &= ~bit;
+            cv::Point next = current + step(bit);
+            cracks[vertex(next.x, next.y)] &= ~opposite(bit);
+
+            // only corners are kept
+            if (bit == lastBit && chain.size() > 1) chain.back() = next;
+            else chain.push_back(next);
+            lastBit = bit;
+            current = next;
+
+            if (current == start || degree[vertex(current.x, current.y)] != 2) break;
+            bit = lowestBit(cracks[vertex(current.x, current.y)]);
+        }
+        return chain;
+    };
+
+    auto addBorder = [&](std::vector<cv::Point>&& chain, bool closed) {
+        if (closed && chain.size() > 1 && chain.back() == chain.front()) chain.pop_back();
+        if (chain.size() < 2) return;
+        if (opts.tolerance > 0 && chain.size() > 2) {
+            std::vector<cv::Point> simplified;
+            cv::approxPolyDP(chain, simplified, opts.tolerance, closed);
+            chain = std::move(simplified);
+        }
+        borders.push_back(std::move(chain));
+        closedBorder.push_back(closed);
+    };
+
+    // open chains between junctions and image edges first, then the closed loops left over
+    for (int pass = 0; pass < 2; pass++) {
+        for (int y = 0; y <= height; y++) {
+            for (int x = 0; x <= width; x++) {
+                size_t v = vertex(x, y);
+                if (pass == 0 && degree[v] == 2) continue;
+                while (cracks[v]) {
+                    addBorder(follow(x, y, lowestBit(cracks[v])), pass == 1);
+                }
+            }
+        }
+    }
+}
+
+int vectorExport::legendHeight() const
+{
+    if (!opts.legend || colours.empty()) return 0;
+    int perRow = std::max(1, (size.width - 10) / legendSpacing);
+    int rows = (static_cast<int>(colours.size()) + perRow - 1) / perRow;
+    return rows * legendRow + 10;
+}
+
+bool vectorExport::writeSVG(const std::string &path) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Error: Could not write " << path << std::endl;
+        return false;
+    }
+
+    const int totalHeight = size.height + legendHeight();
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << size.width << "\" height=\"" << totalHeight
+        << "\" viewBox=\"0 0 " << size.width << " " << totalHeight << "\">\n"
+        << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+
+    // fillable regions, the colour number rides along for colouring apps
+    out << "<g id=\"regions\" fill=\"white\" stroke=\"none\">\n";
+    for (size_t i = 0; i < outlines.size(); i++) {
+        if (outlines[i].size() < 3) continue;
+        out << "<path data-colour=\"" << labelClusters[i] << "\" d=\"";
+        writePath(out, outlines[i], true);
+        out << "\"/>\n";
+    }
+    out << "</g>\n";
+
+    out << "<g id=\"borders\" fill=\"none\" stroke=\"black\" stroke-width=\"" << opts.strokeWidth
+        << "\" stroke-linejoin=\"round\" stroke-linecap=\"round\">\n";
+    for (size_t i = 0; i < borders.size(); i++) {
+        out << "<path d=\"";
+        writePath(out, borders[i], closedBorder[i]);
+        out << "\"/>\n";
+    }
+    out << "</g>\n";
+
+    out << "<g id=\"labels\" font-family=\"Helvetica, Arial, sans-serif\" font-size=\"" << opts.fontSize
+        << "\" text-anchor=\"middle\" dominant-baseline=\"central\">\n";
+    for (size_t i = 0; i < labelPositions.size(); i++) {
+        out << "<text x=\"" << labelPositions[i].x << "\" y=\"" << labelPositions[i].y << "\">" << labelClusters[i] << "</text>\n";
+    }
+    out << "</g>\n";
+
+    if (legendHeight() > 0) {
+        int perRow = std::max(1, (size.width - 10) / legendSpacing);
+        out << "<g id=\"legend\" font-family=\"Helvetica, Arial, sans-serif\" font-size=\"" << opts.fontSize << "\">\n";
+        for (size_t c = 0; c < colours.size(); c++) {
+            int x = 10 + static_cast<int>(c % perRow) * legendSpacing;
+            int y = size.height + 10 + static_cast<int>(c / perRow) * legendRow;
+            out << "<rect x=\"" << x << "\" y=\"" << y << "\" width=\"" << legendSwatch << "\" height=\"" << legendSwatch
+                << "\" fill=\"" << hexColour(colours[c]) << "\" stroke=\"black\" stroke-width=\"0.5\"/>"
+                << "<text x=\"" << x + legendSwatch + 4 << "\" y=\"" << y + legendSwatch / 2 << "\" dominant-baseline=\"central\">" << c << "</text>\n";
+        }
+        out << "</g>\n";
+    }
+    out << "</svg>\n";
+
+    return static_cast<bool>(out);
+}
+
+bool vectorExport::writePDF(const std::string &path) const
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Error: Could not write " << path << std::endl;
+        return false;
+    }
+
+    // PDF puts the origin bottom-left, flip y
+    const int totalHeight = size.height + legendHeight();
+    auto flip = [totalHeight](int y) { return totalHeight - y; };
+    const double digitWidth = 0.556; // Helvetica digit advance, in em
+
+    std::vector<std::streamoff> offsets;
+    auto beginObject = [&]() {
+        offsets.push_back(out.tellp());
+        out << offsets.size() << " 0 obj\n";
+    };
+
+    out << "%PDF-1.4\n";
+    beginObject();
+    out << "<< /Type /Catalog /Pages 2 0 R >>\nendobj\n";
+    beginObject();
+    out << "<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n";
+    beginObject();
+    out << "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " << size.width << " " << totalHeight << "]"
+        << " /Contents 4 0 R /Resources << /Font << /F1 5 0 R >> >> >>\nendobj\n";
+
+    // content stream is written as it is generated, its length goes in object 6
+    beginObject();
+    out << "<< /Length 6 0 R >>\nstream\n";
+    std::streamoff streamStart = out.tellp();
+
+    out << "1 1 1 rg 0 0 " << size.width << " " << totalHeight << " re f\n"
+        << "0 0 0 RG " << opts.strokeWidth << " w 1 J 1 j\n";
+    for (size_t i = 0; i < borders.size(); i++) {
+        const auto& border = borders[i];
+        out << border[0].x << " " << flip(border[0].y) << " m\n";
+        for (size_t p = 1; p < border.size(); p++) {
+            out << border[p].x << " " << flip(border[p].y) << " l\n";
+        }
+        out << (closedBorder[i] ? "h S\n" : "S\n");
+    }
+
+    out << "0 0 0 rg BT /F1 " << opts.fontSize << " Tf\n";
+    for (size_t i = 0; i < labelPositions.size(); i++) {
+        std::string text = std::to_string(labelClusters[i]);
+        double x = labelPositions[i].x - digitWidth * opts.fontSize * text.size() / 2;
+        double y = flip(labelPositions[i].y) - 0.35 * opts.fontSize;
+        out << "1 0 0 1 " << x << " " << y << " Tm (" << text << ") Tj\n";
+    }
+    out << "ET\n";
+
+    if (legendHeight() > 0) {
+        int perRow = std::max(1, (size.width - 10) / legendSpacing);
+        for (size_t c = 0; c < colours.size(); c++) {
+            int x = 10 + static_cast<int>(c % perRow) * legendSpacing;
+            int y = size.height + 10 + static_cast<int>(c / perRow) * legendRow;
+            const cv::Vec3b& bgr = colours[c];
+            out << bgr[2] / 255.0 << " " << bgr[1] / 255.0 << " " << bgr[0] / 255.0 << " rg "
+                << x << " " << flip(y + legendSwatch) << " " << legendSwatch << " " << legendSwatch << " re f\n"
+                << "0.5 w " << x << " " << flip(y + legendSwatch) << " " << legendSwatch << " " << legendSwatch << " re S\n"
+                << "0 0 0 rg BT /F1 " << opts.fontSize << " Tf 1 0 0 1 " << x + legendSwatch + 4 << " "
+                << flip(y + legendSwatch / 2) - 0.35 * opts.fontSize << " Tm (" << c << ") Tj ET\n";
+        }
+    }
+
+    std::streamoff streamLength = out.tellp() - streamStart;
+    out << "endstream\nendobj\n";
+
+    beginObject();
+    out << "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>\nendobj\n";
+    beginObject();
+    out << streamLength << "\nendobj\n";
+
+    std::streamoff xref = out.tellp();
+    out << "xref\n0 " << offsets.size() + 1 << "\n0000000000 65535 f \n";
+    for (std::streamoff offset : offsets) {
+        char entry[21];
+        std::snprintf(entry, sizeof(entry), "%010lld 00000 n \n", static_cast<long long>(offset));
+        out << entry;
+    }
+    out << "trailer\n<< /Size " << offsets.size() + 1 << " /Root 1 0 R >>\nstartxref\n" << xref << "\n%%EOF\n";
+
+    return static_cast<bool>(out);
+}
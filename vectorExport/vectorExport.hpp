@@ -0,0 +1,38 @@
+#pragma once
+#include <opencv4/opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include "regionInfo.hpp"
+
+struct vectorExportOptions {
+    double tolerance = 1.0;     // Douglas-Peucker epsilon in pixels, 0 keeps every corner
+    double strokeWidth = 1.5;
+    double fontSize = 10;
+    bool legend = true;         // palette swatches under the template
+};
+
+// Resolution independent template output. Region outlines are written as
+// simplified paths; the visible borders come from the cracks between
+// neighbouring regions, so every shared edge is emitted once and neighbours
+// meet exactly. Labels sit at the region poles, palette as a legend.
+class vectorExport
+{
+    public:
+        vectorExport(cv::Size size, const std::vector<regionInfo> &regions, const std::vector<cv::Point> &labelPositions,
+                     const cv::Mat &palette, const vectorExportOptions &opts = vectorExportOptions());
+        bool writeSVG(const std::string &path) const;
+        bool writePDF(const std::string &path) const;
+
+    private:
+        cv::Size size;
+        vectorExportOptions opts;
+        std::vector<std::vector<cv::Point>> outlines; // simplified, one per region
+        std::vector<std::vector<cv::Point>> borders;  // shared borders, each edge once
+        std::vector<bool> closedBorder;
+        std::vector<cv::Point> labelPositions;
+        std::vector<int> labelClusters;
+        std::vector<cv::Vec3b> colours;               // BGR palette
+
+        void buildBorders(const std::vector<regionInfo> &regions);
+        int legendHeight() const;
+};